@@ -0,0 +1,455 @@
+#include "../include/arena.h"
+#include "../include/combat_event.h"
+#include "../include/combat_visitor.h"
+#include "../include/distance_kernel.h"
+#include "../include/event_bus.h"
+#include "../include/factory.h"
+#include "../include/knight.h"
+#include "../include/npc_parser.h"
+#include "../include/observer.h"
+#include "../include/world_generator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// набор бенчмарков горячих путей арены; миры синтетические (WorldGenerator), сеть не нужна
+//   6_lab_bench [--filter=подстрока] [--json=файл|-] [--min-time=сек] [--quick]
+
+namespace {
+
+struct Options {
+    std::string filter;
+    std::string jsonPath;
+    double minTime = 0.3;
+    bool quick = false;
+};
+
+struct Result {
+    std::string name;
+    size_t repetitions = 0;
+    double items = 0.0;      // единиц работы за один прогон
+    double medianNs = 0.0;   // время одного прогона
+    double minNs = 0.0;
+    double maxNs = 0.0;
+};
+
+// значение, которое компилятор не может выбросить
+volatile uint64_t sink = 0;
+
+// прогоны повторяются, пока суммарное время не превысит minTime;
+// setup выполняется перед каждым прогоном и в замер не входит
+class Harness {
+public:
+    explicit Harness(const Options& options) : options_(options) {}
+
+    void run(const std::string& name, double items,
+             const std::function<void()>& setup, const std::function<void()>& body) {
+        if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos) return;
+
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> samples;
+        double total = 0.0;
+        const size_t minReps = options_.quick ? 1 : 3;
+        const size_t maxReps = 1000;
+        setup();
+        body();  // прогрев
+        while (samples.size() < maxReps && (samples.size() < minReps || total < options_.minTime * 1e9)) {
+            setup();
+            const auto start = Clock::now();
+            body();
+            const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            samples.push_back(ns);
+            total += ns;
+        }
+
+        std::sort(samples.begin(), samples.end());
+        Result result;
+        result.name = name;
+        result.repetitions = samples.size();
+        result.items = items;
+        result.medianNs = samples[samples.size() / 2];
+        result.minNs = samples.front();
+        result.maxNs = samples.back();
+        results_.push_back(result);
+
+        std::ostream& out = options_.jsonPath == "-" ? std::cerr : std::cout;
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-52s %12.3f ms %12.1f ns/item %6zu reps",
+                      name.c_str(), result.medianNs / 1e6, result.medianNs / std::max(items, 1.0),
+                      result.repetitions);
+        out << line << std::endl;
+    }
+
+    void run(const std::string& name, double items, const std::function<void()>& body) {
+        run(name, items, [] {}, body);
+    }
+
+    void writeJson(std::ostream& out) const {
+        char date[64];
+        const std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        out << "{\n  \"context\": {\n"
+            << "    \"date\": \"" << date << "\",\n"
+            << "    \"kernel_isa\": \"" << kernelIsaName(detectKernelIsa()) << "\",\n"
+            << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+            << "    \"build\": \"release\"\n"
+#else
+            << "    \"build\": \"debug\"\n"
+#endif
+            << "  },\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const Result& r = results_[i];
+            out << "    {\"name\": \"" << r.name << "\""
+                << ", \"repetitions\": " << r.repetitions
+                << ", \"items\": " << r.items
+                << ", \"median_ns\": " << r.medianNs
+                << ", \"min_ns\": " << r.minNs
+                << ", \"max_ns\": " << r.maxNs
+                << ", \"items_per_second\": " << (r.medianNs > 0 ? r.items * 1e9 / r.medianNs : 0.0)
+                << "}" << (i + 1 < results_.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+
+private:
+    Options options_;
+    std::vector<Result> results_;
+};
+
+WorldSpec worldSpec(size_t count, int size, WorldDistribution distribution, uint64_t seed) {
+    WorldSpec spec;
+    spec.count = count;
+    spec.width = size;
+    spec.height = size;
+    spec.distribution = distribution;
+    spec.clusterRadius = std::max(size / 20, 1);
+    spec.seed = seed;
+    return spec;
+}
+
+class CountingObserver : public Observer {
+public:
+    void notify(const CombatEvent& event) override { sink = sink + event.tick; }
+};
+
+class DiscardingTextObserver : public TextObserver {
+public:
+    using TextObserver::notify;
+    void notify(const std::string& event) override { sink = sink + event.size(); }
+};
+
+void benchBattles(Harness& harness, const Options& options) {
+    struct Case {
+        size_t count;
+        int size;
+        double range;
+        WorldDistribution distribution;
+    };
+    const auto uniform = WorldDistribution::Uniform;
+    const auto clustered = WorldDistribution::Clustered;
+    std::vector<Case> cases = {
+        {1000, 500, 10.0, uniform},   {10000, 500, 10.0, uniform},  {10000, 500, 10.0, clustered},
+        {10000, 100, 2.0, uniform},   {2000, 500, 10.0, WorldDistribution::AllInRange},
+        {100000, 500, 2.0, uniform},  {100000, 500, 10.0, uniform}, {100000, 500, 2.0, clustered},
+    };
+    if (options.quick) cases.resize(5);
+
+    for (const Case& c : cases) {
+        const WorldSpec spec = worldSpec(c.count, c.size, c.distribution, 1);
+        for (ExecutionPolicy policy : {ExecutionPolicy::Sequential, ExecutionPolicy::Parallel}) {
+            if (policy == ExecutionPolicy::Parallel && c.count < 100000) continue;
+            std::ostringstream name;
+            name << "battle/n=" << c.count << "/size=" << c.size << "/range=" << c.range
+                 << (c.distribution == uniform ? "/uniform" : c.distribution == clustered ? "/clustered" : "/all-in-range")
+                 << (policy == ExecutionPolicy::Parallel ? "/parallel" : "");
+
+            std::unique_ptr<Arena> arena;
+            harness.run(name.str(), static_cast<double>(c.count),
+                [&] {
+                    arena = std::make_unique<Arena>(c.size, c.size);
+                    generateWorld(spec, *arena);
+                },
+                [&] { arena->startBattle(c.range, policy); });
+        }
+    }
+}
+
+void benchFiles(Harness& harness, const Options& options) {
+    const size_t count = options.quick ? 20000 : 200000;
+    Arena source(500, 500);
+    generateWorld(worldSpec(count, 500, WorldDistribution::Uniform, 2), source);
+
+    const std::string textFile = "bench_world.txt";
+    const std::string binaryFile = "bench_world.bin";
+    source.saveToFile(textFile);
+    source.saveToFile(binaryFile, SnapshotFormat::Binary);
+
+    const double items = static_cast<double>(count);
+    harness.run("file/save/text", items, [&] { source.saveToFile(textFile); });
+    harness.run("file/save/binary", items, [&] { source.saveToFile(binaryFile, SnapshotFormat::Binary); });
+
+    std::unique_ptr<Arena> target;
+    auto fresh = [&] { target = std::make_unique<Arena>(500, 500); };
+    harness.run("file/load/text", items, fresh, [&] { target->loadFromFile(textFile, SnapshotFormat::Text); });
+    harness.run("file/load/text/parallel", items, fresh, [&] {
+        target->loadFromFile(textFile, SnapshotFormat::Text, ExecutionPolicy::Parallel);
+    });
+    harness.run("file/load/binary", items, fresh, [&] { target->loadFromFile(binaryFile, SnapshotFormat::Binary); });
+
+    std::remove(textFile.c_str());
+    std::remove(binaryFile.c_str());
+}
+
+// волна спавна: NPC по одному и одним пакетом
+void benchSpawning(Harness& harness) {
+    const size_t count = 50000;
+    WorldGenerator generator(worldSpec(count, 500, WorldDistribution::Uniform, 2));
+    std::vector<NpcSpawn> wave;
+    wave.reserve(count);
+    GeneratedNpc npc;
+    while (generator.next(npc)) {
+        wave.push_back({std::string(npcTypeName(npc.type)), std::string(npc.name), npc.x, npc.y});
+    }
+
+    const double items = static_cast<double>(count);
+    std::unique_ptr<Arena> target;
+    auto fresh = [&] { target = std::make_unique<Arena>(500, 500); };
+    harness.run("spawn/createAndAddNpc", items, fresh, [&] {
+        for (const NpcSpawn& npc : wave) target->createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+    });
+    harness.run("spawn/createAndAddNpcs", items, fresh, [&] { target->createAndAddNpcs(wave); });
+
+    // то же поштучное добавление, но каждое публикует версию для читателей
+    auto freshPublishing = [&] {
+        fresh();
+        target->enableSnapshots();
+    };
+    harness.run("spawn/createAndAddNpc/snapshots", items, freshPublishing, [&] {
+        for (const NpcSpawn& npc : wave) target->createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+    });
+}
+
+// запросы по области: индекс арены против перебора объектов NPC с distanceTo
+void benchQueries(Harness& harness, const Options& options) {
+    const size_t count = options.quick ? 20000 : 200000;
+    const int size = 10000;
+    const WorldSpec spec = worldSpec(count, size, WorldDistribution::Uniform, 3);
+    Arena arena(size, size);
+    generateWorld(spec, arena);
+    std::vector<std::unique_ptr<Npc>> npcs;
+    WorldGenerator generator(spec);
+    GeneratedNpc npc;
+    while (generator.next(npc)) {
+        npcs.push_back(NpcFactory::createNpc(npc.type, std::string(npc.name), npc.x, npc.y));
+    }
+
+    const size_t queries = 200;
+    std::vector<std::pair<int, int>> points;
+    for (size_t q = 0; q < queries; ++q) {
+        points.push_back({static_cast<int>(q * 7919 % size), static_cast<int>(q * 104729 % size)});
+    }
+    const double radius = 50.0;
+    const size_t k = 10;
+
+    arena.kNearest(0, 0, 1);  // индекс строится при первом запросе
+    harness.run("query/radius/index", static_cast<double>(queries), [&] {
+        for (const auto& [x, y] : points) sink = sink + arena.queryRadius(x, y, radius).size();
+    });
+    harness.run("query/radius/brute-force", static_cast<double>(queries), [&] {
+        for (const auto& [x, y] : points) {
+            Knight probe(x, y, "probe");
+            for (const auto& other : npcs) sink = sink + (other->distanceTo(probe) <= radius);
+        }
+    });
+    harness.run("query/kNearest/index", static_cast<double>(queries), [&] {
+        for (const auto& [x, y] : points) sink = sink + arena.kNearest(x, y, k, NpcType::Squirrel).size();
+    });
+    harness.run("query/kNearest/brute-force", static_cast<double>(queries), [&] {
+        std::vector<std::pair<double, const Npc*>> found;
+        for (const auto& [x, y] : points) {
+            Knight probe(x, y, "probe");
+            found.clear();
+            for (const auto& other : npcs) {
+                if (other->getTypeId() == NpcType::Squirrel) found.push_back({other->distanceTo(probe), other.get()});
+            }
+            const size_t take = std::min(k, found.size());
+            std::partial_sort(found.begin(), found.begin() + take, found.end());
+            sink = sink + take;
+        }
+    });
+}
+
+void benchParsing(Harness& harness) {
+    std::vector<std::string> lines;
+    WorldGenerator generator(worldSpec(10000, 500, WorldDistribution::Uniform, 3));
+    GeneratedNpc npc;
+    while (generator.next(npc)) {
+        lines.push_back(std::string(npcTypeName(npc.type)) + " " + std::string(npc.name) + " " +
+                        std::to_string(npc.x) + " " + std::to_string(npc.y));
+    }
+    const double items = static_cast<double>(lines.size());
+
+    harness.run("parse/createFromString", items, [&] {
+        for (const auto& line : lines) {
+            sink = sink + NpcFactory::createFromString(line)->getX();
+        }
+    });
+    harness.run("parse/parseNpcLine", items, [&] {
+        for (const auto& line : lines) {
+            sink = sink + parseNpcLine(line).x;
+        }
+    });
+}
+
+void benchCombatRules(Harness& harness) {
+    const size_t rounds = 1 << 20;
+    harness.run("rules/canKill", static_cast<double>(rounds), [&] {
+        uint64_t kills = 0;
+        for (size_t i = 0; i < rounds; ++i) {
+            const NpcType a = static_cast<NpcType>(i % NPC_TYPE_COUNT);
+            const NpcType b = static_cast<NpcType>((i / NPC_TYPE_COUNT) % NPC_TYPE_COUNT);
+            kills += CombatVisitor::canKill(a, b);
+        }
+        sink = sink + kills;
+    });
+
+    // пакетное ядро проверки дальности на каждом доступном наборе инструкций
+    const size_t count = 4096;
+    std::vector<int> xs(count), ys(count);
+    for (size_t i = 0; i < count; ++i) {
+        xs[i] = static_cast<int>((i * 7919) % 501);
+        ys[i] = static_cast<int>((i * 104729) % 501);
+    }
+    std::vector<uint32_t> out(count);
+    const double range = 100.0;
+    const int64_t maxD2 = maxSquaredDistance(range);
+
+    // тот же блок через Npc::distanceTo по парам: база для сравнения с ядром
+    std::vector<std::unique_ptr<Npc>> npcs;
+    npcs.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        npcs.push_back(NpcFactory::createNpc(NpcType::Knight, "bench_distance" + std::to_string(i), xs[i], ys[i]));
+    }
+    harness.run("rules/distanceTo", static_cast<double>(count) * 64, [&] {
+        for (size_t a = 0; a < 64; ++a) {
+            uint64_t hits = 0;
+            for (size_t i = 0; i < count; ++i) {
+                if (npcs[a]->distanceTo(*npcs[i]) <= range) ++hits;
+            }
+            sink = sink + hits;
+        }
+    });
+
+    for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::Sse2, KernelIsa::Avx2}) {
+        if (static_cast<int>(isa) > static_cast<int>(detectKernelIsa())) continue;
+        harness.run(std::string("rules/selectInRange/") + kernelIsaName(isa), static_cast<double>(count) * 64, [&] {
+            for (size_t a = 0; a < 64; ++a) {
+                sink = sink + selectInRange(xs[a], ys[a], xs.data(), ys.data(), count, maxD2, out.data(), isa);
+            }
+        });
+    }
+}
+
+void benchObservers(Harness& harness, const Options& options) {
+    const size_t events = options.quick ? 10000 : 100000;
+    std::vector<CombatEvent> batch;
+    for (size_t i = 0; i < events; ++i) {
+        batch.push_back(CombatEvent{i % 5 ? CombatEventKind::Kill : CombatEventKind::MutualKill,
+                                    NpcType::Knight, NpcType::Squirrel, 0, 0,
+                                    static_cast<int32_t>(i % 500), 0, i});
+    }
+    const double items = static_cast<double>(events);
+
+    Arena structured(10, 10);
+    structured.addObserver(std::make_shared<CountingObserver>());
+    harness.run("observers/sync/structured", items, [&] {
+        for (const auto& event : batch) structured.notifyObservers(event);
+        structured.flushEvents();
+    });
+
+    Arena text(10, 10);
+    text.addObserver(std::make_shared<DiscardingTextObserver>());
+    harness.run("observers/sync/text", items, [&] {
+        for (const auto& event : batch) text.notifyObservers(event);
+        text.flushEvents();
+    });
+
+    Arena async(10, 10);
+    async.addObserver(std::make_shared<CountingObserver>());
+    async.enableAsyncEvents();
+    harness.run("observers/async/structured", items, [&] {
+        for (const auto& event : batch) async.notifyObservers(event);
+        async.flushEvents();
+    });
+}
+
+bool parseArgs(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&arg](const char* prefix) -> const char* {
+            const size_t length = std::strlen(prefix);
+            return arg.compare(0, length, prefix) == 0 ? arg.c_str() + length : nullptr;
+        };
+        if (const char* v = value("--filter=")) {
+            options.filter = v;
+        } else if (const char* v = value("--json=")) {
+            options.jsonPath = v;
+        } else if (const char* v = value("--min-time=")) {
+            options.minTime = std::atof(v);
+        } else if (arg == "--quick") {
+            options.quick = true;
+            options.minTime = 0.05;
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--filter=substring] [--json=file|-] [--min-time=seconds] [--quick]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 1;
+
+    try {
+        Harness harness(options);
+        benchBattles(harness, options);
+        benchFiles(harness, options);
+        benchSpawning(harness);
+        benchQueries(harness, options);
+        benchParsing(harness);
+        benchCombatRules(harness);
+        benchObservers(harness, options);
+
+        if (options.jsonPath == "-") {
+            harness.writeJson(std::cout);
+        } else if (!options.jsonPath.empty()) {
+            std::ofstream file(options.jsonPath);
+            if (!file.is_open()) {
+                std::cerr << "Cannot open file for writing: " << options.jsonPath << std::endl;
+                return 1;
+            }
+            harness.writeJson(file);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
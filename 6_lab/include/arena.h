@@ -1,45 +1,270 @@
 #pragma once
 #include <string>
 #include "npc.h"
-#include <map>
 #include <memory>
 #include "observer.h"
+#include "npc_store.h"
+#include "spatial_grid.h"
+#include "sharded_grid.h"
+#include "thread_pool.h"
+#include "event_bus.h"
+#include "snapshot.h"
+#include "npc_pool.h"
+#include "arena_stats.h"
+#include "streaming_battle.h"
+#include "npc_parser.h"
+#include "npc_index.h"
+#include "arena_snapshot.h"
+#include <array>
 #include <vector>
+#include <functional>
+#include <span>
 
-#define MAX_WIDTH 500
-#define MAX_HEIGHT 500
+#define MAX_WIDTH 1000000
+#define MAX_HEIGHT 1000000
+
+// размеры арены по умолчанию
+#define DEFAULT_WIDTH 500
+#define DEFAULT_HEIGHT 500
+
+// режим выполнения боя
+enum class ExecutionPolicy {
+    Sequential,
+    Parallel
+};
+
+// параметры боя
+struct BattleOptions {
+    ExecutionPolicy policy = ExecutionPolicy::Sequential;
+    // проверять только пары с NPC, добавленными или сдвинутыми после прошлого боя
+    // (если дальность не больше прошлой, иначе полный перебор; на картах, которые
+    // делятся на плитки, всегда полный перебор)
+    bool incremental = false;
+    // инкрементальный бой и полный перебор вместе, logic_error при расхождении
+    bool verify = false;
+};
+
+// NPC для пакетного добавления через createAndAddNpcs
+struct NpcSpawn {
+    std::string type;
+    std::string name;
+    int x;
+    int y;
+};
+
+// NPC в ответе на запрос по области; имя - строка StringInterner::global()
+struct NpcInfo {
+    NpcType type;
+    std::string_view name;
+    int x;
+    int y;
+};
+
+// случайное блуждание NPC: за ход смещение по каждой оси в [-maxStep, maxStep]
+// с остановкой у края арены; одинаковое зерно даёт одинаковую симуляцию.
+// maxStep не может быть отрицательным, шаг больше размера арены урезается до него
+struct MovePolicy {
+    int maxStep = 1;
+    uint64_t seed = 1;
+};
+
+// замеры одного хода симуляции
+struct TickStats {
+    double moveMs = 0.0;
+    double gridMs = 0.0;
+    double battleMs = 0.0;
+    size_t kills = 0;
+    size_t alive = 0;
+};
+
+struct SimulationReport {
+    std::vector<TickStats> ticks;
+    double totalMs = 0.0;
+};
 
 // арена для сражений npc
 class Arena {
 private:
     int width_, height_;
-    std::map<std::string, std::unique_ptr<Npc>> npcs_;
+    NpcStore store_;
     std::vector<std::shared_ptr<Observer>> observers_;
+    // сетки по типам NPC (номера строк хранилища): NPC проверяются только против
+    // сеток типов, с которыми по таблице убийств возможен бой
+    std::array<SpatialGrid, NPC_TYPE_COUNT> typeGrids_;
+    // плитки для карт, где одна сетка вышла бы грубее дальности
+    ShardedGrid shards_;
+    size_t threadCount_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::unique_ptr<EventBus> bus_;
+    uint64_t tick_;
+    NpcPool npcPool_;
+
+    // индекс для запросов по области, строится при первом запросе
+    mutable NpcIndex index_;
+
+    // id имён NPC, изменённых после последнего боя, и дальность этого боя
+    std::vector<uint32_t> dirty_;
+    double settledRange_;
+
+    // обновляется только при сборке с ARENA_STATS
+    ArenaStats stats_;
+
+    // версии для читателей из других потоков, публикуются после enableSnapshots
+    SnapshotPublisher snapshots_;
+    bool publishing_ = false;
+    // строки последней версии; следующая меняет в них только затронутые пути
+    SnapshotRows snapshotRows_;
 
 public:
-    Arena(int width = MAX_WIDTH, int height = MAX_HEIGHT);
+    Arena(int width = DEFAULT_WIDTH, int height = DEFAULT_HEIGHT);
 
     // работа с файлами
     void loadFromFile(const std::string& filename);
     void saveToFile(const std::string& filename) const;
+    // Auto при чтении определяет формат по сигнатуре, при записи означает текст
+    void loadFromFile(const std::string& filename, SnapshotFormat format);
+    // Parallel: текст режется на куски по границам строк и разбирается в пуле потоков
+    void loadFromFile(const std::string& filename, SnapshotFormat format, ExecutionPolicy policy);
+    void saveToFile(const std::string& filename, SnapshotFormat format) const;
 
     // управление наблюдателями
     void addObserver(std::shared_ptr<Observer> observer);
     void removeObserver(std::shared_ptr<Observer> observer);
 
+    // асинхронная доставка событий через фоновый поток
+    void enableAsyncEvents(EventBus::Config config = {});
+    void disableAsyncEvents();
+    // барьер: все события доставлены наблюдателям
+    void flushEvents();
+
     // боевая механика
     void startBattle(double range);
+    void startBattle(double range, ExecutionPolicy policy);
+    void startBattle(double range, const BattleOptions& options);
+    // бой над файлом input без загрузки в арену: память ограничена options.memoryBudget,
+    // выжившие пишутся в output, события получают наблюдатели арены; NPC арены не участвуют
+    StreamingReport startStreamingBattle(const std::string& input, const std::string& output,
+                                         double range, const StreamingOptions& options = {});
+
+    // ticks ходов: перемещение всех NPC, затем бой на дальности range
+    // (отрицательная дальность, как и в startBattle, - без боёв);
+    // размеры сетки задаются один раз, каждый ход она заполняется в те же буферы
+    SimulationReport simulate(size_t ticks, double range, const MovePolicy& move);
+    SimulationReport simulate(size_t ticks, double range, const MovePolicy& move, ExecutionPolicy policy);
+
+    // число потоков для параллельного боя (0 - по числу ядер)
+    void setThreadCount(size_t count);
 
     // добавление npc
     void addNpc(std::unique_ptr<Npc> npc);
+    // арена хранит только столбцы: из объекта копируются поля, сам он сразу
+    // возвращается в пул, так что выигрыша по памяти здесь нет
+    void addNpc(NpcPool::Ptr npc);
     void createAndAddNpc(const std::string& type, 
                          const std::string& name, 
                          int x, int y);
+    // пакетное добавление: весь пакет проверяется до вставки и добавляется целиком
+    // или не добавляется вовсе; исключения те же, что у addNpc, в тексте - номер
+    // первой ошибочной строки пакета и имя; объекты Npc не забираются
+    void addNpcs(std::span<const std::unique_ptr<Npc>> npcs);
+    void createAndAddNpcs(std::span<const NpcSpawn> npcs);
+
+    // перемещение NPC по имени
+    void moveNpc(const std::string& name, int x, int y);
+
+    // запросы по области, ответ в порядке имён; расстояние - как в бою
+    // (NPC на расстоянии не больше radius, пустой ответ при отрицательном radius)
+    std::vector<NpcInfo> queryRadius(int x, int y, double radius) const;
+    std::vector<NpcInfo> queryRect(int x0, int y0, int x1, int y1) const;
+    // k ближайших к точке NPC (только типа type, если задан) по возрастанию
+    // расстояния, при равном - по имени; NPC в самой точке тоже попадает в ответ
+    std::vector<NpcInfo> kNearest(int x, int y, size_t k) const;
+    std::vector<NpcInfo> kNearest(int x, int y, size_t k, NpcType type) const;
+
+    // снимки для читателей из других потоков: после включения добавление, перемещение,
+    // загрузка, бой (и каждый ход симуляции) и очистка публикуют новую версию.
+    // Добавление и перемещение одного NPC стоят O(log N), версии делят неизменённые
+    // строки; бой, загрузка и очистка пересобирают все строки. Сама арена по-прежнему
+    // работает в одном потоке
+    void enableSnapshots();
+    // текущая опубликованная версия, из любого потока без блокировок; guard не должен
+    // пережить арену
+    SnapshotPublisher::ReadGuard readSnapshot() const;
 
     // информация и очистка
     void printAllNpcs() const;
     size_t getNpcCount() const;
     void clear();
 
-    void notifyObservers(const std::string& event);
+    // пул для объектов NPC, которые вызывающий код держит у себя (арене объекты
+    // не нужны); объекты не должны пережить арену
+    NpcPool& npcPool();
+
+    // накопленная статистика (нули, если арена собрана без ARENA_STATS)
+    ArenaStats getStats() const;
+    void resetStats();
+    // запись статистики в файл в текстовом формате Prometheus
+    void dumpStats(const std::string& filename) const;
+
+    void notifyObservers(const CombatEvent& event);
+
+private:
+    // убийство в паре: first всегда NPC с меньшим именем
+    struct Kill;
+
+    // проверка границ и имени, добавление строки в хранилище
+    void addRow(std::string_view name, NpcType type, int x, int y);
+    void addRow(uint32_t nameId, NpcType type, int x, int y);
+    // пакет целиком или ничего (исключение для первой по порядку ошибочной строки)
+    void addRows(std::span<const ParsedNpc> rows);
+    // вставка пакета без отметки изменённых; при ошибке хранилище откатывается
+    void insertRows(std::span<const ParsedNpc> rows);
+    // удаление строк хранилища с номерами не меньше size
+    void truncateRows(size_t size);
+    // разбор кусков текста в пуле, затем одна последовательная проверка имён
+    void loadTextParallel(std::string_view text);
+
+    // пул потоков создаётся при первом параллельном вызове
+    ThreadPool& pool();
+
+    // публикация текущего состояния, если снимки включены: полная пересборка строк
+    // или только добавленных с номера from / одной перемещённой строки
+    void publishSnapshot();
+    void publishAppended(size_t from);
+    void publishMoved(uint32_t row);
+    void sendSnapshot();
+
+    // индекс запросов, построенный по текущему хранилищу
+    const NpcIndex& queryIndex() const;
+
+    // номера строк хранилища в порядке имён
+    std::vector<uint32_t> rowsByName() const;
+
+    // размеры сеток по типам под дальность; раскладка строк хранилища по ним
+    void resetTypeGrids(double range);
+    void buildTypeGrids();
+    void clearTypeGrids();
+    // раскладка всех NPC для полного поиска: сетки по типам или плитки (тогда true)
+    bool layoutForBattle(double range);
+    // полный поиск убийств после layoutForBattle
+    std::vector<Kill> scanKills(double range, ExecutionPolicy policy, bool sharded);
+
+    // сбор убийств по блокам [begin, end) из count не меньше grain, при Parallel - в пуле потоков
+    std::vector<Kill> gatherKills(size_t count, ExecutionPolicy policy, size_t grain,
+                                  const std::function<void(size_t begin, size_t end, std::vector<Kill>& out)>& collect);
+    // поиск убийств для NPC из ячеек [begin, end) сеток по типам, пронумерованных подряд
+    void collectKills(double range, size_t begin, size_t end, std::vector<Kill>& out) const;
+    // поиск убийств для NPC из плиток [shardBegin, shardEnd)
+    void collectShardKills(double range, size_t shardBegin, size_t shardEnd, std::vector<Kill>& out) const;
+    // поиск убийств для изменённых строк rows[begin, end)
+    void collectDirtyKills(double range, const std::vector<uint32_t>& rows, size_t begin, size_t end,
+                           const std::vector<uint8_t>& isDirty, std::vector<Kill>& out) const;
+    // пары одной строки; isDirty == nullptr при полном переборе
+    // (x, y) - координаты строки в системе сетки grid; ownGrid - в grid есть и сама
+    // строка i, тогда пару при полном переборе берёт меньший номер
+    void collectRowKills(const SpatialGrid& grid, uint32_t i, int x, int y, int64_t maxD2,
+                         const std::vector<uint8_t>* isDirty, bool ownGrid,
+                         std::vector<uint32_t>& inRange, std::vector<Kill>& out) const;
+    // рассылка событий и удаление погибших
+    void resolveKills(std::vector<Kill>& kills);
 };
\ No newline at end of file
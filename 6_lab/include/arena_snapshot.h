@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "arena_stats.h"
+#include "npc_store.h"
+#include "npc_type.h"
+
+// строки снимка: постоянный массив - дерево с ветвлением WIDTH, листья хранят
+// по WIDTH строк. Изменение строки или добавление в конец копирует только путь
+// от корня до листа, остальные узлы общие с прежними версиями; узел, который
+// не держит ни один снимок (use_count == 1), меняется на месте. Счётчики
+// ссылок трогает только писатель, читатели узлы не копируют
+class SnapshotRows {
+public:
+    struct Row {
+        NpcType type;
+        uint32_t nameId;
+        int x;
+        int y;
+    };
+
+    size_t size() const { return size_; }
+    const Row& operator[](size_t i) const {
+        const Node* node = root_.get();
+        for (unsigned shift = shift_; shift > 0; shift -= BITS) {
+            node = node->children[(i >> shift) & MASK].get();
+        }
+        return node->rows[i & MASK];
+    }
+    // обход строк по порядку
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        if (root_) forEachIn(*root_, shift_, fn);
+    }
+
+    // только писатель
+    void assign(const NpcStore& store);
+    void set(size_t i, const Row& row);
+    void push_back(const Row& row);
+
+private:
+    static constexpr unsigned BITS = 6;
+    static constexpr size_t WIDTH = size_t{1} << BITS;
+    static constexpr size_t MASK = WIDTH - 1;
+
+    struct Node {
+        std::vector<std::shared_ptr<Node>> children;  // внутренний узел
+        std::vector<Row> rows;                        // лист
+    };
+
+    std::shared_ptr<Node> root_;
+    unsigned shift_ = 0;
+    size_t size_ = 0;
+
+    static Node& editable(std::shared_ptr<Node>& node);
+    template <typename Fn>
+    static void forEachIn(const Node& node, unsigned shift, Fn& fn) {
+        if (shift == 0) {
+            for (const Row& row : node.rows) fn(row);
+            return;
+        }
+        for (const auto& child : node.children) forEachIn(*child, shift - BITS, fn);
+    }
+};
+
+// неизменяемый снимок арены: NPC в порядке строк хранилища
+struct ArenaSnapshot {
+    uint64_t version = 0;  // номер публикации, 0 - пустой снимок до первой
+    uint64_t tick = 0;     // число проведённых боёв
+    int width = 0;
+    int height = 0;
+    SnapshotRows rows;
+    ArenaStats stats;
+
+    size_t size() const { return rows.size(); }
+    // имя из StringInterner::global(), чтение без блокировок
+    std::string_view name(size_t i) const;
+    // вывод в формате Arena::printAllNpcs (в порядке имён)
+    void print(std::ostream& out) const;
+};
+
+// публикация снимков по схеме RCU с эпохами: писатель (поток арены) подменяет
+// указатель на текущий снимок, читатели из любых потоков берут его без блокировок.
+// Читатель объявляет эпоху в своём слоте, старый снимок уходит в повторное
+// использование, только когда ни один слот не держит эпоху его замены
+class SnapshotPublisher {
+public:
+    // одновременно живущих ReadGuard; сверх этого числа читатель ждёт свободный слот
+    static constexpr size_t MAX_READERS = 64;
+
+    SnapshotPublisher();
+    // читателей к этому моменту быть не должно
+    ~SnapshotPublisher();
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    // доступ к снимку; снимок не меняется и не освобождается, пока guard жив
+    class ReadGuard {
+    public:
+        ReadGuard(ReadGuard&& other) noexcept;
+        ReadGuard& operator=(ReadGuard&&) = delete;
+        ~ReadGuard();
+
+        const ArenaSnapshot& operator*() const { return *snapshot_; }
+        const ArenaSnapshot* operator->() const { return snapshot_; }
+
+    private:
+        friend class SnapshotPublisher;
+        ReadGuard(std::atomic<uint64_t>* slot, const ArenaSnapshot* snapshot)
+            : slot_(slot), snapshot_(snapshot) {}
+        std::atomic<uint64_t>* slot_;
+        const ArenaSnapshot* snapshot_;
+    };
+
+    ReadGuard read() const;
+
+    // только из потока писателя: буфер для следующей версии (старый снимок,
+    // который уже никто не читает, или новый) и его публикация
+    std::unique_ptr<ArenaSnapshot> acquire();
+    void publish(std::unique_ptr<ArenaSnapshot> snapshot);
+
+    // снимки, ожидающие ухода читателей (для тестов и статистики)
+    size_t retiredCount() const;
+
+private:
+    static constexpr uint64_t IDLE = UINT64_MAX;
+    // свободные запасные буферы писателя: текущий и следующий - двойная буферизация
+    static constexpr size_t MAX_SPARES = 2;
+
+    // слот читателя на отдельной строке кеша
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    std::atomic<ArenaSnapshot*> current_;
+    std::atomic<uint64_t> epoch_{1};
+    mutable std::array<Slot, MAX_READERS> slots_;
+
+    // только писатель: заменённые снимки с эпохой замены и запасные буферы
+    std::vector<std::pair<uint64_t, std::unique_ptr<ArenaSnapshot>>> retired_;
+    std::vector<std::unique_ptr<ArenaSnapshot>> spares_;
+    uint64_t nextVersion_ = 1;
+
+    void reclaim();
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// счётчики арены собираются только при сборке с опцией CMake ARENA_STATS
+// (макрос ARENA_ENABLE_STATS); без неё макросы ниже раскрываются в пустоту
+#ifdef ARENA_ENABLE_STATS
+inline constexpr bool ARENA_STATS_ENABLED = true;
+#define ARENA_STATS_ONLY(...) __VA_ARGS__
+#else
+inline constexpr bool ARENA_STATS_ENABLED = false;
+#define ARENA_STATS_ONLY(...)
+#endif
+
+// накопленная статистика арены; время - в миллисекундах
+struct ArenaStats {
+    // бои (и ходы симуляции)
+    uint64_t battles = 0;
+    uint64_t pairsExamined = 0;  // кандидаты из соседних ячеек
+    uint64_t pairsInRange = 0;   // из них в пределах дальности
+    uint64_t kills = 0;
+    uint64_t removed = 0;
+    uint64_t eventsDispatched = 0;
+
+    double battleMs = 0.0;    // весь startBattle
+    double gridMs = 0.0;      // раскладка по сетке
+    double scanMs = 0.0;      // поиск пар
+    double resolveMs = 0.0;   // упорядочивание убийств
+    double dispatchMs = 0.0;  // раздача событий наблюдателям
+    double removalMs = 0.0;   // удаление погибших
+
+    // загрузка из файлов
+    uint64_t loads = 0;
+    uint64_t npcsLoaded = 0;
+    uint64_t bytesLoaded = 0;
+    double loadMs = 0.0;
+};
+
+// счётчики горячего цикла: у каждого потока свои, в арену попадает приращение за блок
+struct ScanCounters {
+    uint64_t pairsExamined = 0;
+    uint64_t pairsInRange = 0;
+};
+
+inline ScanCounters& threadScanCounters() {
+    thread_local ScanCounters counters;
+    return counters;
+}
+
+// прибавляет время жизни объекта к полю статистики
+class StatTimer {
+public:
+    explicit StatTimer(double& ms) : ms_(ms), start_(std::chrono::steady_clock::now()) {}
+    ~StatTimer() { stop(); }
+    // досрочная остановка; повторные вызовы ничего не делают
+    void stop() {
+        if (stopped_) return;
+        stopped_ = true;
+        ms_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    }
+    StatTimer(const StatTimer&) = delete;
+    StatTimer& operator=(const StatTimer&) = delete;
+
+private:
+    double& ms_;
+    std::chrono::steady_clock::time_point start_;
+    bool stopped_ = false;
+};
+
+// текстовый формат Prometheus
+void writePrometheusStats(const ArenaStats& stats, std::ostream& out);
+// запись во временный файл и переименование: читатель не увидит файл наполовину
+void writePrometheusStats(const ArenaStats& stats, const std::string& filename);
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "npc_type.h"
+
+// вид боевого события
+enum class CombatEventKind : uint8_t {
+    Kill,        // атакующий убил защищающегося
+    MutualKill   // оба убили друг друга
+};
+
+// компактная запись о событии боя без строк; имена - id в StringInterner::global()
+struct CombatEvent {
+    CombatEventKind kind;
+    NpcType attackerType;
+    NpcType defenderType;
+    uint32_t attackerId;
+    uint32_t defenderId;
+    int32_t x, y;       // позиция защищающегося
+    uint64_t tick;      // номер боя на арене
+};
+
+// текст события в прежнем формате, формируется только по запросу
+void formatEvent(const CombatEvent& event, std::string& out);
+std::string formatEvent(const CombatEvent& event);
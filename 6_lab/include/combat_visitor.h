@@ -1,6 +1,7 @@
 #pragma once
 #include "visitor.h"
 #include "npc.h"
+#include "npc_registry.h"
 
 // посетитель для обработки боевой логики между NPC
 class CombatVisitor : public Visitor {
@@ -8,12 +9,17 @@ public:
     // проверка, может ли атакующий убить защищающегося
     bool canKill(Npc* attacker, Npc* defender);
 
+    // одна выборка из таблицы убийств, без строк и выделений памяти
+    static constexpr bool canKill(NpcType attacker, NpcType defender) {
+        return KILL_MATRIX[npcTypeIndex(attacker)][npcTypeIndex(defender)];
+    }
+
+    // бой возможен хотя бы в одну сторону: пары остальных типов в бою не проверяются
+    static constexpr bool canFight(NpcType first, NpcType second) {
+        return canKill(first, second) || canKill(second, first);
+    }
+
     void visit(Knight&) override {}
     void visit(Squirrel&) override {}
     void visit(Pegasus&) override {}
-
-private:
-    bool knightVs(const std::string& defenderType);
-    bool squirrelVs(const std::string& defenderType);
-    bool pegasusVs(const std::string& defenderType);
-};
\ No newline at end of file
+};
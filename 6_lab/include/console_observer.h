@@ -3,9 +3,15 @@
 #include <iostream>
 
 // наблюдатель, который логирует события в консоль
-class ConsoleObserver : public Observer {
+class ConsoleObserver : public TextObserver {
 public:
+    using TextObserver::notify;
+
     void notify(const std::string& event) override {
-        std::cout << "[COMBAT EVENT] " << event << std::endl;
+        std::cout << "[COMBAT EVENT] " << event << '\n';
+    }
+
+    void flush() override {
+        std::cout.flush();
     }
 };
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// набор инструкций для пакетной проверки дальности
+enum class KernelIsa {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// лучший набор инструкций, доступный на этом процессоре (определяется один раз)
+KernelIsa detectKernelIsa();
+const char* kernelIsaName(KernelIsa isa);
+
+// наибольший целый квадрат расстояния k, для которого sqrt(k) <= range;
+// сравнение d2 <= k даёт ровно тот же ответ, что и distanceTo() <= range
+int64_t maxSquaredDistance(double range);
+
+// отбор защитников из блока координат: в out пишутся номера i, для которых
+// (x - xs[i])^2 + (y - ys[i])^2 <= maxD2, возвращается их количество
+size_t selectInRange(int x, int y, const int* xs, const int* ys, size_t count,
+                     int64_t maxD2, uint32_t* out);
+size_t selectInRange(int x, int y, const int* xs, const int* ys, size_t count,
+                     int64_t maxD2, uint32_t* out, KernelIsa isa);
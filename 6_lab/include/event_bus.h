@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "observer.h"
+
+// поведение при заполненном кольцевом буфере
+enum class BackPressure {
+    Block,  // производитель ждёт освобождения места
+    Drop,   // событие отбрасывается и учитывается в dropped()
+    Grow    // событие уходит в дополнительную очередь без ограничения
+};
+
+// асинхронная шина событий: арена кладёт события в кольцевой буфер без блокировок
+// (один производитель, один потребитель), фоновый поток раздаёт их наблюдателям пачками
+class EventBus {
+public:
+    struct Config {
+        size_t capacity = 1 << 16;
+        size_t batchSize = 256;
+        BackPressure policy = BackPressure::Block;
+    };
+
+    EventBus();
+    explicit EventBus(Config config);
+    ~EventBus();
+    EventBus(const EventBus&) = delete;
+    EventBus& operator=(const EventBus&) = delete;
+
+    // замена списка получателей (дожидается доставки уже опубликованного)
+    void setObservers(std::vector<std::shared_ptr<Observer>> observers);
+
+    void publish(const CombatEvent& event);
+    // барьер: возврат после доставки всех опубликованных событий
+    void flush();
+
+    size_t dropped() const;
+
+private:
+    Config config_;
+    std::vector<CombatEvent> ring_;
+    size_t mask_;
+    std::atomic<size_t> head_{0};  // следующий для чтения (потребитель)
+    std::atomic<size_t> tail_{0};  // следующий для записи (производитель)
+
+    std::mutex overflowMutex_;
+    std::deque<CombatEvent> overflow_;
+    std::atomic<bool> overflowActive_{false};
+
+    std::mutex observersMutex_;
+    std::vector<std::shared_ptr<Observer>> observers_;
+
+    std::mutex wakeMutex_;
+    std::condition_variable wakeUp_;
+    std::condition_variable delivered_;
+    std::atomic<bool> sleeping_{false};
+    std::atomic<uint64_t> publishedCount_{0};
+    std::atomic<uint64_t> deliveredCount_{0};
+    std::atomic<size_t> dropped_{0};
+    std::exception_ptr error_;
+    bool stopping_ = false;
+
+    std::thread worker_;
+
+    void wakeConsumer();
+    size_t takeBatch(std::vector<CombatEvent>& batch);
+    void deliver(std::vector<CombatEvent>& batch);
+    void run();
+};
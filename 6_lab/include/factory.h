@@ -2,6 +2,7 @@
 #include <memory>
 #include <string>
 #include "npc.h"
+#include "npc_pool.h"
 
 // фабричный класс npc
 class NpcFactory {
@@ -16,4 +17,14 @@ public:
         int x, 
         int y
     );
+    static std::unique_ptr<Npc> createNpc(NpcType type, const std::string& name, int x, int y);
+
+    // создание в пуле вместо кучи
+    static NpcPool::Ptr createNpc(
+        NpcPool& pool,
+        const std::string& type,
+        const std::string& name,
+        int x,
+        int y
+    );
 };
\ No newline at end of file
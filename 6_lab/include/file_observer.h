@@ -1,20 +1,42 @@
 #pragma once
 #include "observer.h"
-#include <fstream>
+#include <chrono>
+#include <cstddef>
 #include <string>
 
-// наблюдатель, который логирует события в файл
-class FileObserver : public Observer {
+// наблюдатель, который логирует события в файл: файл открыт всё время,
+// строки копятся в буфере и сбрасываются по размеру, по времени или в конце пачки
+class FileObserver : public TextObserver {
 public:
-    FileObserver(const std::string& filename) : filename_(filename) {}
+    using TextObserver::notify;
 
-    void notify(const std::string& event) override {
-        std::ofstream file(filename_, std::ios::app);
-        if (file.is_open()) {
-            file << event << std::endl;
-        }
-    }
+    struct Options {
+        size_t bufferSize = 1 << 20;                    // сброс при заполнении буфера
+        std::chrono::milliseconds flushInterval{0};     // сброс по времени (0 - выключен)
+        bool flushOnBatch = true;                       // сброс в конце каждой пачки событий
+        size_t maxFileSize = 0;                         // ротация по размеру (0 - без ротации)
+        size_t maxFiles = 5;                            // число старых файлов filename.1 ... filename.N
+        bool syncOnFlush = false;                       // fsync после каждого сброса
+    };
+
+    FileObserver(const std::string& filename);
+    FileObserver(const std::string& filename, Options options);
+    ~FileObserver() override;
+    FileObserver(const FileObserver&) = delete;
+    FileObserver& operator=(const FileObserver&) = delete;
+
+    void notify(const std::string& event) override;
+    void flush() override;
 
 private:
     std::string filename_;
-};
\ No newline at end of file
+    Options options_;
+    int fd_;
+    size_t fileSize_;
+    std::string buffer_;
+    std::chrono::steady_clock::time_point lastFlush_;
+
+    void open();
+    void writeOut();
+    void rotate();
+};
@@ -4,10 +4,12 @@
 
 // странствующий рыцарь (убивает белок)
 class Knight : public Npc {
-private:
-    static const std::string type_;
-
 public:
+    // тип, имя типа и строка таблицы убийств
+    static constexpr NpcType typeId = NpcType::Knight;
+    static constexpr std::string_view typeName = "Knight";
+    using Prey = PreyList<NpcType::Squirrel>;
+
     Knight(int x, int y, const std::string& name);
     
     void printInfo() const override;
@@ -1,18 +1,22 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <memory>
+#include "npc_type.h"
 
 class Visitor;
 
-// абстрактный класс персонажа
+// абстрактный класс персонажа; имя хранится как id в StringInterner::global(),
+// поэтому строка имени остаётся в интернере и после уничтожения NPC
 class Npc {
 private:
     int x_, y_;
-    std::string type_;
-    std::string name_;
+    NpcType type_;
+    uint32_t nameId_;
 
 public:
-    Npc(int x, int y, const std::string& type, const std::string& name);
+    Npc(int x, int y, NpcType type, std::string_view name);
     virtual ~Npc() = default;
 
     // печать данных персонажа
@@ -25,8 +29,10 @@ public:
     double distanceTo(const Npc& other) const;
 
     // доступ к полям
-    std::string getName() const;
-    std::string getType() const;
+    std::string_view getName() const;
+    std::string_view getType() const;
+    uint32_t getNameId() const;
+    NpcType getTypeId() const;
     int getX() const;
     int getY() const;
 
@@ -0,0 +1,75 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "npc_store.h"
+#include "npc_type.h"
+
+// индекс NPC для запросов по области: карта делится на ячейки (не больше
+// CELLS_PER_SIDE на сторону), у каждой ячейки свой список записей; в отличие от
+// SpatialGrid списки меняются на месте при добавлении, удалении и перемещении NPC.
+// Пока индекс не построен (build), изменения ничего не стоят
+class NpcIndex {
+public:
+    static constexpr int CELLS_PER_SIDE = 256;
+
+    struct Entry {
+        uint32_t nameId;
+        int x;
+        int y;
+        NpcType type;
+    };
+
+    bool built() const;
+    // построение по всем строкам хранилища
+    void build(const NpcStore& store, int width, int height);
+    // сброс: следующий запрос построит индекс заново
+    void invalidate();
+
+    void insert(uint32_t nameId, NpcType type, int x, int y);
+    void erase(uint32_t nameId, int x, int y);
+    void move(uint32_t nameId, int fromX, int fromY, int x, int y);
+    // удаление строк хранилища, отмеченных в маске (до их удаления из хранилища);
+    // при массовом удалении индекс сбрасывается
+    void eraseMarked(const std::vector<uint64_t>& marked, const NpcStore& store);
+
+    // записи в прямоугольнике [x0, x1] x [y0, y1]
+    template <typename Fn>
+    void forEachInRect(int x0, int y0, int x1, int y1, Fn&& fn) const {
+        if (x0 > x1 || y0 > y1) return;
+        const int cx0 = cellCoord(x0, cols_), cx1 = cellCoord(x1, cols_);
+        const int cy0 = cellCoord(y0, rows_), cy1 = cellCoord(y1, rows_);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                // внутренние ячейки целиком в прямоугольнике, проверка нужна только на краях
+                const bool inner = cx > cx0 && cx < cx1 && cy > cy0 && cy < cy1;
+                for (const Entry& entry : cells_[static_cast<size_t>(cy) * cols_ + cx]) {
+                    if (inner || (entry.x >= x0 && entry.x <= x1 && entry.y >= y0 && entry.y <= y1)) {
+                        fn(entry);
+                    }
+                }
+            }
+        }
+    }
+
+    // k ближайших к (x, y) записей, подходящих под filter (nullptr - любой тип),
+    // по возрастанию расстояния, при равном - по имени
+    std::vector<Entry> nearest(int x, int y, size_t k, const NpcType* filter) const;
+
+private:
+    bool built_ = false;
+    int side_ = 1;
+    int cols_ = 0, rows_ = 0;
+    std::vector<std::vector<Entry>> cells_;
+    size_t size_ = 0;
+    std::array<size_t, NPC_TYPE_COUNT> typeCounts_{};
+
+    int cellCoord(int value, int limit) const {
+        return std::clamp(value / side_, 0, limit - 1);
+    }
+    std::vector<Entry>& cellOf(int x, int y) {
+        return cells_[static_cast<size_t>(cellCoord(y, rows_)) * cols_ + cellCoord(x, cols_)];
+    }
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "npc_type.h"
+
+// строка текстового файла NPC после разбора, имя указывает в исходный буфер
+struct ParsedNpc {
+    NpcType type;
+    std::string_view name;
+    int x;
+    int y;
+};
+
+// разбор строки "Тип имя x y" без выделения памяти; ошибки те же, что у
+// NpcFactory::createFromString: runtime_error при неверном формате строки,
+// invalid_argument при неизвестном типе
+ParsedNpc parseNpcLine(std::string_view line);
+
+// разбор всех непустых строк текста (разделитель '\n', как у std::getline)
+template <typename Fn>
+void forEachNpcLine(std::string_view text, Fn&& fn) {
+    while (!text.empty()) {
+        const size_t end = text.find('\n');
+        const std::string_view line = text.substr(0, end);
+        if (!line.empty()) {
+            fn(parseNpcLine(line));
+        }
+        if (end == std::string_view::npos) break;
+        text.remove_prefix(end + 1);
+    }
+}
+
+// деление текста на куски примерно по chunkBytes байт, границы только после '\n'
+std::vector<std::string_view> splitNpcText(std::string_view text, size_t chunkBytes);
@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "npc.h"
+#include "npc_type.h"
+
+// пул памяти для объектов NPC: у каждого конкретного типа свой слаб из блоков
+// одинаковых ячеек, освобождённые ячейки идут в список свободных и переиспользуются;
+// как и арена, пул не потокобезопасен. Пул полезен коду, который долго держит много
+// объектов Npc; арена объектов не хранит, и при добавлении в неё пул лишь
+// переиспользует одну ячейку
+class NpcPool {
+public:
+    // возврат объекта в пул вместо delete
+    struct Deleter {
+        NpcPool* pool;
+        void operator()(Npc* npc) const;
+    };
+    using Ptr = std::unique_ptr<Npc, Deleter>;
+
+    NpcPool() = default;
+    // если объекты ещё выданы, блоки остаются неосвобождёнными (утечка вместо порчи памяти)
+    ~NpcPool();
+    NpcPool(const NpcPool&) = delete;
+    NpcPool& operator=(const NpcPool&) = delete;
+
+    Ptr create(NpcType type, const std::string& name, int x, int y);
+
+    // число выданных и ещё не возвращённых объектов
+    size_t live() const;
+    // число ячеек во всех блоках
+    size_t capacity() const;
+
+    // освобождение всех блоков разом, без обхода ячеек; при выданных объектах
+    // бросает std::logic_error и ничего не освобождает
+    void clear();
+
+private:
+    struct Slab {
+        std::vector<void*> blocks;
+        void* freeList = nullptr;  // следующая свободная ячейка хранится в самой ячейке
+        size_t cells = 0;
+        size_t live = 0;
+    };
+
+    static constexpr size_t CELLS_PER_BLOCK = 256;
+
+    std::array<Slab, NPC_TYPE_COUNT> slabs_;
+
+    void* allocate(NpcType type);
+    void deallocate(NpcType type, void* cell);
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <string_view>
+#include "npc_type.h"
+#include "knight.h"
+#include "squirrel.h"
+#include "pegasus.h"
+
+// перечень всех классов NPC: новый тип добавляется сюда одной строкой,
+// правила боя и имя берутся из самого класса (typeId, typeName, Prey)
+template <typename... Npcs>
+struct NpcTypeList {};
+
+using AllNpcTypes = NpcTypeList<Knight, Squirrel, Pegasus>;
+
+using KillTable = std::array<std::array<bool, NPC_TYPE_COUNT>, NPC_TYPE_COUNT>;
+using TypeNameTable = std::array<std::string_view, NPC_TYPE_COUNT>;
+
+// идеальный хеш имён типов: слот по (seed, длина, первая и последняя буква),
+// seed подбирается при компиляции так, чтобы все имена попали в разные слоты
+constexpr size_t TYPE_HASH_SIZE = [] {
+    size_t size = 1;
+    while (size < NPC_TYPE_COUNT * 2) size *= 2;
+    return size;
+}();
+constexpr uint8_t TYPE_HASH_EMPTY = 0xFF;
+
+struct TypeHashTable {
+    uint32_t seed;
+    std::array<uint8_t, TYPE_HASH_SIZE> slots;
+};
+
+constexpr size_t typeNameSlot(std::string_view name, uint32_t seed) {
+    uint32_t h = (seed ^ static_cast<uint32_t>(name.size())) * 0x01000193u;
+    if (!name.empty()) {
+        h = (h ^ static_cast<unsigned char>(name.front())) * 0x01000193u;
+        h = (h ^ static_cast<unsigned char>(name.back())) * 0x01000193u;
+    }
+    return (h >> 16) & (TYPE_HASH_SIZE - 1);
+}
+
+namespace npc_registry_detail {
+
+template <NpcType... Prey>
+constexpr void fillRow([[maybe_unused]] KillTable& table, [[maybe_unused]] NpcType attacker,
+                       PreyList<Prey...>) {
+    ((table[npcTypeIndex(attacker)][npcTypeIndex(Prey)] = true), ...);
+}
+
+template <typename... Npcs>
+constexpr KillTable buildKills(NpcTypeList<Npcs...>) {
+    KillTable table{};
+    (fillRow(table, Npcs::typeId, typename Npcs::Prey{}), ...);
+    return table;
+}
+
+template <typename... Npcs>
+constexpr TypeNameTable buildNames(NpcTypeList<Npcs...>) {
+    TypeNameTable names{};
+    ((names[npcTypeIndex(Npcs::typeId)] = Npcs::typeName), ...);
+    return names;
+}
+
+constexpr TypeHashTable buildTypeHash(const TypeNameTable& names) {
+    for (uint32_t seed = 0; seed < 100000; ++seed) {
+        TypeHashTable table{seed, {}};
+        for (auto& slot : table.slots) slot = TYPE_HASH_EMPTY;
+        bool ok = true;
+        for (size_t i = 0; i < NPC_TYPE_COUNT && ok; ++i) {
+            auto& slot = table.slots[typeNameSlot(names[i], seed)];
+            ok = slot == TYPE_HASH_EMPTY;
+            slot = static_cast<uint8_t>(i);
+        }
+        if (ok) return table;
+    }
+    return TypeHashTable{0, {}};
+}
+
+constexpr bool typeHashValid(const TypeHashTable& table, const TypeNameTable& names) {
+    for (size_t i = 0; i < NPC_TYPE_COUNT; ++i) {
+        if (table.slots[typeNameSlot(names[i], table.seed)] != i) return false;
+    }
+    return true;
+}
+
+// каждый NpcType описан ровно одним классом
+template <typename... Npcs>
+constexpr bool typesComplete(NpcTypeList<Npcs...>) {
+    std::array<int, NPC_TYPE_COUNT> seen{};
+    ((++seen[npcTypeIndex(Npcs::typeId)]), ...);
+    for (int count : seen) {
+        if (count != 1) return false;
+    }
+    return sizeof...(Npcs) == NPC_TYPE_COUNT;
+}
+
+}
+
+static_assert(npc_registry_detail::typesComplete(AllNpcTypes{}),
+              "every NpcType needs exactly one class in AllNpcTypes");
+
+// таблица убийств: KILL_MATRIX[атакующий][защищающийся]
+inline constexpr KillTable KILL_MATRIX = npc_registry_detail::buildKills(AllNpcTypes{});
+inline constexpr TypeNameTable NPC_TYPE_NAMES = npc_registry_detail::buildNames(AllNpcTypes{});
+
+// таблица разбора имён типов
+inline constexpr TypeHashTable NPC_TYPE_HASH = npc_registry_detail::buildTypeHash(NPC_TYPE_NAMES);
+
+static_assert(npc_registry_detail::typeHashValid(NPC_TYPE_HASH, NPC_TYPE_NAMES),
+              "no collision-free seed for NpcType names");
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "npc_type.h"
+
+// хранилище NPC по столбцам: координаты, типы и имена лежат в непрерывных массивах,
+// имена интернированы, строка находится по id имени через открытую хеш-таблицу
+class NpcStore {
+private:
+    std::vector<int> x_, y_;
+    std::vector<NpcType> typeId_;
+    std::vector<uint32_t> nameId_;
+
+    // слот таблицы: (id имени << 32) | номер строки
+    std::vector<uint64_t> slots_;
+
+    size_t slotOf(uint32_t nameId) const;
+    void placeIndex(uint32_t nameId, uint32_t row);
+    void eraseIndex(uint32_t nameId);
+    void growIndex();
+    void rebuildIndex();
+
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    // добавление строки, возвращает её номер
+    uint32_t insert(uint32_t nameId, NpcType typeId, int x, int y);
+    // поиск строки по id имени, npos если нет
+    uint32_t find(uint32_t nameId) const;
+    // удаление строки: на её место переезжает последняя
+    void erase(uint32_t row);
+    // удаление всех строк, отмеченных в битовой маске (строка row - бит row % 64
+    // слова row / 64), возвращает число удалённых
+    size_t eraseMarked(const std::vector<uint64_t>& marked);
+    // новые координаты строки
+    void move(uint32_t row, int x, int y);
+
+    void reserve(size_t count);
+    void clear();
+    size_t size() const;
+
+    // доступ к столбцам
+    const std::vector<int>& x() const;
+    const std::vector<int>& y() const;
+    const std::vector<NpcType>& typeId() const;
+    const std::vector<uint32_t>& nameId() const;
+
+    std::string_view name(uint32_t row) const;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// компактный идентификатор типа NPC
+enum class NpcType : uint8_t {
+    Knight,
+    Squirrel,
+    Pegasus
+};
+
+constexpr size_t NPC_TYPE_COUNT = 3;
+
+constexpr size_t npcTypeIndex(NpcType type) {
+    return static_cast<size_t>(type);
+}
+
+// список типов, которых убивает класс NPC (строка таблицы убийств)
+template <NpcType... Prey>
+struct PreyList {};
+
+// имя типа для вывода и файлов
+std::string_view npcTypeName(NpcType type);
+// разбор имени типа, false если тип неизвестен
+bool parseNpcType(std::string_view name, NpcType& type);
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include "combat_event.h"
 
 // интерфейс паттерна наблюдатель для уведомлений о событиях
 class Observer {
@@ -7,5 +8,23 @@ public:
     virtual ~Observer() = default;
 
     // метод уведомления, вызываемый при возникновении событий
+    virtual void notify(const CombatEvent& event) = 0;
+
+    // конец пачки событий: буферизующие наблюдатели сбрасывают вывод
+    virtual void flush() {}
+};
+
+// адаптер для текстовых наблюдателей: событие превращается в прежнюю строку
+// только здесь, в буфере, который переиспользуется между событиями
+class TextObserver : public Observer {
+public:
+    void notify(const CombatEvent& event) final {
+        formatEvent(event, text_);
+        notify(text_);
+    }
+
     virtual void notify(const std::string& event) = 0;
-};
\ No newline at end of file
+
+private:
+    std::string text_;
+};
@@ -4,10 +4,12 @@
 
 // пегас (мирный персонаж)
 class Pegasus : public Npc {
-private:
-    static const std::string type_;
-
 public:
+    // тип, имя типа и строка таблицы убийств
+    static constexpr NpcType typeId = NpcType::Pegasus;
+    static constexpr std::string_view typeName = "Pegasus";
+    using Prey = PreyList<>;
+
     Pegasus(int x, int y, const std::string& name);
     
     void printInfo() const override;
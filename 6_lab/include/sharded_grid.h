@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "spatial_grid.h"
+
+// разбиение большой карты на квадратные плитки для боя: у каждой занятой плитки
+// своя сетка по её NPC и ореолу - NPC соседних плиток не дальше ширины ореола
+// от её края; плитки обрабатываются независимо и параллельно
+class ShardedGrid {
+public:
+    // ячеек сетки на сторону плитки
+    static constexpr int TILE_CELLS = 256;
+
+    // одна сетка на всю карту при такой дальности вышла бы грубее дальности
+    static bool needed(int width, int height, double range);
+
+    // раскладка строк (xs[i], ys[i]) по плиткам
+    void build(const int* xs, const int* ys, size_t count, double range);
+    void clear();
+
+    // число занятых плиток
+    size_t shardCount() const;
+
+    // сетка плитки shard с ореолом: в grid попадают номера строк своих и соседних NPC
+    // в координатах со сдвигом (x - offsetX, y - offsetY), в own - номера строк самой плитки
+    struct Offset {
+        int x;
+        int y;
+    };
+    Offset buildShard(size_t shard, SpatialGrid& grid, std::vector<uint32_t>& own) const;
+
+private:
+    const int* xs_ = nullptr;
+    const int* ys_ = nullptr;
+    int side_ = 1;   // сторона плитки
+    int halo_ = 1;   // ширина ореола, не меньше дальности
+    double range_ = 0.0;
+    int64_t tilesX_ = 1;
+
+    // строки, упорядоченные по плиткам: (ключ плитки << 32) | номер строки
+    std::vector<uint64_t> order_;
+    // ключи занятых плиток и начало каждой в order_
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> start_;
+
+    // номер занятой плитки с ключом key или shardCount()
+    size_t findShard(uint64_t key) const;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped_file.h"
+#include "npc_store.h"
+#include "npc_type.h"
+
+// формат файла с NPC
+enum class SnapshotFormat {
+    Auto,   // по сигнатуре файла (только для чтения)
+    Text,   // строки "Тип имя x y"
+    Binary  // двоичный снимок по столбцам
+};
+
+// двоичный снимок, версия 1 (порядок байтов - как у машины, записавшей файл):
+//   заголовок SnapshotHeader
+//   смещения имён    uint32[count + 1]
+//   байты имён       char[stringBytes], выравнивание до 4
+//   координаты x     int32[count]
+//   координаты y     int32[count]
+//   типы             uint8[count]
+// контрольная сумма считается по всему, что идёт после заголовка
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t count;
+    uint64_t stringBytes;
+    uint64_t checksum;
+};
+
+inline constexpr char SNAPSHOT_MAGIC[8] = {'N', 'P', 'C', 'S', 'N', 'A', 'P', '\0'};
+inline constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+// определение формата по первым байтам файла
+SnapshotFormat detectSnapshotFormat(const std::string& filename);
+
+// запись строк rows хранилища в двоичный снимок
+void writeBinarySnapshot(const std::string& filename, const NpcStore& store,
+                         const std::vector<uint32_t>& rows);
+
+// получатель NPC при потоковой записи
+using SnapshotSink = std::function<void(NpcType type, std::string_view name, int x, int y)>;
+
+// потоковая запись двоичного снимка в ограниченной памяти: replay(sink) должен при каждом
+// вызове выдавать одну и ту же последовательность NPC, она проходится по разу на столбец
+void writeBinarySnapshot(const std::string& filename,
+                         const std::function<void(const SnapshotSink& sink)>& replay);
+
+// двоичный снимок, отображённый в память: проверяется целиком при открытии,
+// имена читаются прямо из отображения
+class MappedSnapshot {
+public:
+    explicit MappedSnapshot(const std::string& filename);
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+    size_t size() const { return count_; }
+    size_t bytes() const { return file_.size(); }
+    std::string_view name(size_t i) const {
+        return std::string_view(names_ + offsets_[i], offsets_[i + 1] - offsets_[i]);
+    }
+    int x(size_t i) const { return xs_[i]; }
+    int y(size_t i) const { return ys_[i]; }
+    NpcType type(size_t i) const { return static_cast<NpcType>(types_[i]); }
+
+private:
+    MappedFile file_;
+    size_t count_;
+    const uint32_t* offsets_;
+    const char* names_;
+    const int32_t* xs_;
+    const int32_t* ys_;
+    const uint8_t* types_;
+};
+
+// перевод файла из одного формата в другой (формат входа определяется сам)
+void convertSnapshot(const std::string& input, const std::string& output, SnapshotFormat format);
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// равномерная сетка для поиска соседей (размер ячейки не меньше дальности боя);
+// записи лежат одним массивом, упорядоченным по ячейкам, поэтому три соседние
+// ячейки одной строки сетки - один непрерывный блок
+class SpatialGrid {
+private:
+    int cols_ = 0, rows_ = 0;
+    double cellSize_ = 1.0;
+
+    // начало ячейки c в xs_/ys_/ids_ - start_[c], конец - start_[c + 1]
+    std::vector<uint32_t> start_;
+    std::vector<int> xs_, ys_;
+    std::vector<uint32_t> ids_;
+    size_t maxBlock_ = 0;
+
+    // записи, добавленные через insert и ещё не разложенные по ячейкам
+    std::vector<int> pendingXs_, pendingYs_;
+    std::vector<uint32_t> pendingIds_;
+    // номер ячейки каждой записи (рабочий буфер сортировки)
+    std::vector<uint32_t> cellOf_;
+
+    int cellCoord(int value, int limit) const;
+    void sortByCell(const int* xs, const int* ys, const uint32_t* ids, size_t count);
+
+public:
+    // ограничение на число ячеек, чтобы маленькая дальность не раздувала сетку
+    static constexpr size_t MAX_CELLS = 1 << 20;
+
+    // перестроение сетки под размеры арены и дальность; при нехватке ячеек они укрупняются
+    void reset(int width, int height, double range, size_t maxCells = MAX_CELLS);
+    void insert(uint32_t id, int x, int y);
+    // раскладка добавленных записей по ячейкам (сортировка подсчётом)
+    void build();
+    // замена содержимого сетки точками (xs[i], ys[i]) с id = i; буферы переиспользуются
+    void build(const int* xs, const int* ys, size_t count);
+    void clear();
+
+    double cellSize() const;
+    size_t cellCount() const;
+    // номер ячейки, в которую попадает точка
+    size_t cellIndex(int x, int y) const;
+
+    // наибольший блок, который получает обработчик forEachNeighbourCell
+    size_t maxCellSize() const;
+
+    // обход ячейки точки и восьми соседних целыми блоками: по одному блоку на строку
+    // сетки, fn(xs, ys, ids, count) получает непрерывные столбцы трёх ячеек
+    template <typename Fn>
+    void forEachNeighbourCell(int x, int y, Fn&& fn) const {
+        const int cx = cellCoord(x, cols_);
+        const int cy = cellCoord(y, rows_);
+        const int left = cx > 0 ? cx - 1 : 0;
+        const int right = cx + 1 < cols_ ? cx + 1 : cx;
+        for (int ny = cy - 1; ny <= cy + 1; ++ny) {
+            if (ny < 0 || ny >= rows_) continue;
+            const size_t row = static_cast<size_t>(ny) * cols_;
+            const uint32_t begin = start_[row + left];
+            const uint32_t end = start_[row + right + 1];
+            if (begin == end) continue;
+            fn(xs_.data() + begin, ys_.data() + begin, ids_.data() + begin, end - begin);
+        }
+    }
+
+    // обход ячеек [begin, end) по порядку: fn(xs, ys, ids, count) получает столбцы ячейки
+    template <typename Fn>
+    void forEachCell(size_t begin, size_t end, Fn&& fn) const {
+        for (size_t c = begin; c < end; ++c) {
+            const uint32_t from = start_[c];
+            const uint32_t to = start_[c + 1];
+            if (from == to) continue;
+            fn(xs_.data() + from, ys_.data() + from, ids_.data() + from, to - from);
+        }
+    }
+
+    // обход всех записей в ячейке точки и в восьми соседних
+    template <typename Fn>
+    void forEachNeighbour(int x, int y, Fn&& fn) const {
+        forEachNeighbourCell(x, y, [&](const int* xs, const int* ys, const uint32_t* ids, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                fn(ids[i], xs[i], ys[i]);
+            }
+        });
+    }
+};
@@ -4,10 +4,12 @@
 
 // белка (нападает на пегасов)
 class Squirrel : public Npc {
-private:
-    static const std::string type_;
-
 public:
+    // тип, имя типа и строка таблицы убийств
+    static constexpr NpcType typeId = NpcType::Squirrel;
+    static constexpr std::string_view typeName = "Squirrel";
+    using Prey = PreyList<NpcType::Pegasus>;
+
     Squirrel(int x, int y, const std::string& name);
     
     void printInfo() const override;
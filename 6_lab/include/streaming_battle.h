@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "combat_event.h"
+
+// параметры боя над файлом, который не помещается в память
+struct StreamingOptions {
+    // память под сортируемые куски и окно полос, байт
+    size_t memoryBudget = size_t{64} << 20;
+    // каталог для временных файлов
+    std::string tempDir = ".";
+};
+
+// итог боя над файлом
+struct StreamingReport {
+    size_t npcs = 0;
+    size_t survivors = 0;
+    size_t kills = 0;
+    size_t runs = 0;         // отсортированных кусков на диске
+    size_t strips = 0;       // непустых полос
+    size_t peakWindow = 0;   // наибольшее число NPC в окне
+};
+
+// бой над текстовым файлом NPC в ограниченной памяти: файл сортируется на диске
+// по полосам высотой не меньше дальности, затем полосы проходятся по порядку,
+// в памяти только текущая и предыдущая. Пары и исходы те же, что у
+// Arena::startBattle; события идут по полосам (внутри полосы - в порядке имён),
+// выжившие пишутся в output в порядке полос. Имена на уникальность не проверяются,
+// в StringInterner::global() попадают только имена участников событий.
+// Ошибки разбора и границ - до записи output; runtime_error, если полоса не
+// помещается в memoryBudget.
+StreamingReport streamingBattle(const std::string& input, const std::string& output, double range,
+                                int width, int height, const StreamingOptions& options,
+                                const std::function<void(const CombatEvent&)>& emit, uint64_t tick);
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// интернер строк: каждой строке соответствует стабильный 32-битный id,
+// байты строк живут до конца программы, поэтому string_view не устаревают
+class StringInterner {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    StringInterner();
+    ~StringInterner();
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    // общий интернер для имён NPC. Записи не освобождаются: ни clear(), ни гибель
+    // NPC в бою, ни повторный loadFromFile их не удаляют, так что память растёт с
+    // числом разных имён за всё время работы процесса (повторное имя ничего не стоит).
+    // Освобождать нельзя: снимки арены, объекты Npc и события боя держат id и
+    // читают имена по ним без блокировок. Следить за ростом можно через size()
+    static StringInterner& global();
+
+    // добавление строки (или возврат существующего id)
+    uint32_t intern(std::string_view str);
+    // поиск без добавления, npos если строки нет
+    uint32_t find(std::string_view str) const;
+    // чтение по id без блокировок
+    std::string_view view(uint32_t id) const;
+
+    size_t size() const;
+
+private:
+    struct Entry {
+        const char* data;
+        uint32_t size;
+        uint32_t hash;
+    };
+
+    // шард: своя хеш-таблица и свой буфер символов под своим мьютексом
+    struct Shard {
+        mutable std::mutex mutex;
+        std::vector<uint32_t> slots;
+        size_t used = 0;
+        std::vector<std::unique_ptr<char[]>> chunks;
+        char* cursor = nullptr;
+        size_t left = 0;
+    };
+
+    static constexpr size_t SHARD_COUNT = 16;
+    static constexpr size_t SEGMENT_BITS = 16;
+    static constexpr size_t SEGMENT_SIZE = size_t{1} << SEGMENT_BITS;
+    static constexpr size_t SEGMENT_COUNT = size_t{1} << (32 - SEGMENT_BITS);
+
+    Shard shards_[SHARD_COUNT];
+    std::unique_ptr<std::atomic<Entry*>[]> segments_;
+    std::atomic<uint32_t> nextId_{0};
+
+    static uint32_t hashOf(std::string_view str);
+    const Entry& entry(uint32_t id) const;
+    Entry& allocateEntry(uint32_t id);
+    const char* storeChars(Shard& shard, std::string_view str);
+    uint32_t findIn(const Shard& shard, std::string_view str, uint32_t hash) const;
+    void grow(Shard& shard);
+};
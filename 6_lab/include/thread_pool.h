@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// пул потоков с перехватом задач: у каждого потока своя очередь,
+// свободный поток забирает работу с хвоста чужой очереди
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const;
+
+    // параллельный цикл по [0, count) блоками по grain элементов;
+    // fn(номер блока, начало, конец), вызывающий поток тоже выполняет задачи
+    void parallelFor(size_t count, size_t grain,
+                     const std::function<void(size_t chunk, size_t begin, size_t end)>& fn);
+
+    // число блоков, на которые parallelFor разобьёт диапазон
+    static size_t chunkCount(size_t count, size_t grain);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex sleepMutex_;
+    std::condition_variable wakeUp_;
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> nextQueue_{0};
+    bool stopping_ = false;
+
+    void push(Task task);
+    bool tryRun(size_t home);
+    void workerLoop(size_t index);
+};
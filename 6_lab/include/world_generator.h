@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "npc_type.h"
+#include "snapshot.h"
+
+class Arena;
+
+// расположение NPC на карте
+enum class WorldDistribution {
+    Uniform,    // равномерно по всей карте
+    Clustered,  // плотные скопления вокруг случайных центров
+    AllInRange  // худший случай: все NPC попарно на расстоянии не больше range
+};
+
+// параметры синтетического мира
+struct WorldSpec {
+    size_t count = 1000;
+    int width = 500;
+    int height = 500;
+    // доли типов (индекс - npcTypeIndex), нормировать не нужно
+    std::array<double, NPC_TYPE_COUNT> typeWeights{1.0, 1.0, 1.0};
+    WorldDistribution distribution = WorldDistribution::Uniform;
+    size_t clusters = 16;
+    // радиус больше стороны мира урезается до неё
+    int clusterRadius = 10;
+    // дальность для AllInRange
+    double range = 10.0;
+    uint64_t seed = 1;
+    // имена - префикс и порядковый номер, поэтому они уникальны внутри мира
+    std::string namePrefix = "npc";
+};
+
+// NPC из генератора; имя действительно до следующего вызова next
+struct GeneratedNpc {
+    NpcType type;
+    std::string_view name;
+    int x;
+    int y;
+};
+
+// потоковый генератор: NPC выдаются по одному, память не зависит от count,
+// одинаковые параметры дают один и тот же мир
+class WorldGenerator {
+public:
+    // invalid_argument при неверных параметрах
+    explicit WorldGenerator(WorldSpec spec);
+
+    bool next(GeneratedNpc& npc);
+    // начать выдачу заново с первого NPC
+    void reset();
+
+    size_t size() const { return spec_.count; }
+    const WorldSpec& spec() const { return spec_; }
+
+private:
+    WorldSpec spec_;
+    std::array<double, NPC_TYPE_COUNT> cumulative_;
+    std::vector<std::pair<int, int>> centers_;
+    // квадрат AllInRange: левый нижний угол и сторона
+    int boxX_ = 0, boxY_ = 0, boxSide_ = 0;
+
+    uint64_t state_ = 0;
+    size_t index_ = 0;
+    std::string name_;
+
+    uint64_t random();
+    // границы в int64_t: у краёв скопления from и to выходят за пределы int
+    int64_t randomInt(int64_t from, int64_t to);
+};
+
+// мир сразу в арене (имена не должны пересекаться с уже добавленными)
+void generateWorld(const WorldSpec& spec, Arena& arena);
+// мир в файл текстового или двоичного формата, в ограниченной памяти
+void generateWorldFile(const WorldSpec& spec, const std::string& filename,
+                       SnapshotFormat format = SnapshotFormat::Text);
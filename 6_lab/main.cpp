@@ -18,6 +18,9 @@ int main() {
         arena.addObserver(consoleObserver);
         arena.addObserver(fileObserver);
 
+        // события боя доставляются фоновым потоком
+        arena.enableAsyncEvents();
+
         std::cout << "1. Spawning NPCs..." << std::endl;
 
         arena.createAndAddNpc("Knight", "Lancelot", 100, 100);
@@ -40,6 +43,7 @@ int main() {
         std::cout << "4. Starting combat mode (range: 100 meters)..." << std::endl;
         std::cout << "--- BATTLE BEGINS ---" << std::endl;
         arena.startBattle(100.0);
+        arena.flushEvents();
         std::cout << "--- BATTLE ENDS ---" << std::endl;
         std::cout << std::endl;
 
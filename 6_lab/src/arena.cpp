@@ -1,15 +1,25 @@
 #include "../include/arena.h"
 #include "../include/factory.h"
+#include "../include/npc_parser.h"
+#include "../include/mapped_file.h"
 #include "../include/combat_visitor.h"
+#include "../include/string_interner.h"
+#include "../include/distance_kernel.h"
 #include <iostream>
 #include <memory>
 #include <fstream>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <limits>
+#include <chrono>
+#include <cmath>
 
 // конструктор с валидацией границ
-Arena::Arena(int width, int height) {
+Arena::Arena(int width, int height)
+    : threadCount_(0), tick_(0), settledRange_(std::numeric_limits<double>::infinity()) {
     if (width > MAX_WIDTH || height > MAX_HEIGHT) {
         throw std::out_of_range("Arena dimensions exceed maximum limits.");
     }
@@ -18,80 +28,441 @@ Arena::Arena(int width, int height) {
 }
 
 // добавление NPC с валидацией
+// имя NPC уже интернировано, в хранилище попадает его id
 void Arena::addNpc(std::unique_ptr<Npc> npc) {
-    const std::string name = npc->getName();
+    addRow(npc->getNameId(), npc->getTypeId(), npc->getX(), npc->getY());
+    publishAppended(store_.size() - 1);
+}
+
+void Arena::addNpc(NpcPool::Ptr npc) {
+    addRow(npc->getNameId(), npc->getTypeId(), npc->getX(), npc->getY());
+    publishAppended(store_.size() - 1);
+}
 
+void Arena::addRow(std::string_view name, NpcType type, int x, int y) {
+    addRow(StringInterner::global().intern(name), type, x, y);
+}
+
+void Arena::addRow(uint32_t nameId, NpcType type, int x, int y) {
     // проверка границ
-    if (npc->getX() < 0 || npc->getX() > width_ ||
-        npc->getY() < 0 || npc->getY() > height_) {
+    if (x < 0 || x > width_ || y < 0 || y > height_) {
         throw std::out_of_range("NPC coordinates out of bounds.");
     }
 
     // проверка на дубликаты имен
-    if (npcs_.find(name) != npcs_.end()) {
+    if (store_.find(nameId) != NpcStore::npos) {
         throw std::invalid_argument("NPC with this name already exists.");
     }
     
-    npcs_[name] = std::move(npc);
+    store_.insert(nameId, type, x, y);
+    index_.insert(nameId, type, x, y);
+    dirty_.push_back(nameId);
+}
+
+void Arena::moveNpc(const std::string& name, int x, int y) {
+    if (x < 0 || x > width_ || y < 0 || y > height_) {
+        throw std::out_of_range("NPC coordinates out of bounds.");
+    }
+    const uint32_t nameId = StringInterner::global().find(name);
+    const uint32_t row = nameId == StringInterner::npos ? NpcStore::npos : store_.find(nameId);
+    if (row == NpcStore::npos) {
+        throw std::invalid_argument("NPC not found: " + name);
+    }
+    index_.move(nameId, store_.x()[row], store_.y()[row], x, y);
+    store_.move(row, x, y);
+    dirty_.push_back(nameId);
+    publishMoved(row);
 }
 
 void Arena::createAndAddNpc(const std::string& type, 
                             const std::string& name, 
                             int x, int y) {
-    addNpc(NpcFactory::createNpc(type, name, x, y));
+    // сразу в хранилище, без временного объекта NPC
+    NpcType typeId;
+    if (!parseNpcType(type, typeId)) {
+        throw std::invalid_argument("Unknown NPC type: " + type);
+    }
+    addRow(name, typeId, x, y);
+    publishAppended(store_.size() - 1);
+}
+
+void Arena::addNpcs(std::span<const std::unique_ptr<Npc>> npcs) {
+    // имена - строки интернера, они живут до конца программы
+    std::vector<ParsedNpc> rows;
+    rows.reserve(npcs.size());
+    for (const auto& npc : npcs) {
+        rows.push_back({npc->getTypeId(), npc->getName(), npc->getX(), npc->getY()});
+    }
+    addRows(rows);
+}
+
+void Arena::createAndAddNpcs(std::span<const NpcSpawn> npcs) {
+    std::vector<ParsedNpc> rows;
+    rows.reserve(npcs.size());
+    NpcType typeId{};
+    for (size_t i = 0; i < npcs.size(); ++i) {
+        // в волне спавна тип обычно повторяется: строка разбирается, только если сменилась
+        if (i == 0 || npcs[i].type != npcs[i - 1].type) {
+            if (!parseNpcType(npcs[i].type, typeId)) {
+                // строки до неизвестного типа проверяются, чтобы ошибка была первой по порядку
+                const size_t before = store_.size();
+                insertRows(rows);
+                truncateRows(before);
+                throw std::invalid_argument("Unknown NPC type: " + npcs[i].type +
+                                            " (batch row " + std::to_string(i) + ")");
+            }
+        }
+        rows.push_back({typeId, npcs[i].name, npcs[i].x, npcs[i].y});
+    }
+    addRows(rows);
+}
+
+void Arena::addRows(std::span<const ParsedNpc> rows) {
+    const size_t before = store_.size();
+    insertRows(rows);
+    dirty_.reserve(dirty_.size() + rows.size());
+    const auto& names = store_.nameId();
+    dirty_.insert(dirty_.end(), names.begin() + before, names.end());
+    publishAppended(before);
+}
+
+// число строк в блоке проверки границ: внутри блока без ветвлений
+static const size_t BOUNDS_BLOCK = 256;
+
+// номер первой строки за границами арены или count
+static size_t firstOutOfBounds(std::span<const ParsedNpc> rows, int width, int height) {
+    // беззнаковое сравнение отсекает и отрицательные координаты
+    auto outside = [&](const ParsedNpc& npc) {
+        return (static_cast<unsigned>(npc.x) > static_cast<unsigned>(width)) |
+               (static_cast<unsigned>(npc.y) > static_cast<unsigned>(height));
+    };
+    for (size_t begin = 0; begin < rows.size(); begin += BOUNDS_BLOCK) {
+        const size_t end = std::min(rows.size(), begin + BOUNDS_BLOCK);
+        bool bad = false;
+        for (size_t i = begin; i < end; ++i) bad |= outside(rows[i]);
+        if (!bad) continue;
+        for (size_t i = begin; i < end; ++i) {
+            if (outside(rows[i])) return i;
+        }
+    }
+    return rows.size();
+}
+
+// повторы имён ищет хеш-индекс хранилища: строки пакета вставляются по порядку,
+// повтор внутри пакета находится так же, как повтор с уже добавленным NPC
+void Arena::insertRows(std::span<const ParsedNpc> rows) {
+    const size_t before = store_.size();
+    const size_t valid = firstOutOfBounds(rows, width_, height_);
+    store_.reserve(before + valid);
+
+    StringInterner& interner = StringInterner::global();
+    for (size_t i = 0; i < valid; ++i) {
+        const uint32_t nameId = interner.intern(rows[i].name);
+        if (store_.find(nameId) != NpcStore::npos) {
+            truncateRows(before);
+            throw std::invalid_argument("NPC with this name already exists: " + std::string(rows[i].name) +
+                                        " (batch row " + std::to_string(i) + ")");
+        }
+        store_.insert(nameId, rows[i].type, rows[i].x, rows[i].y);
+        index_.insert(nameId, rows[i].type, rows[i].x, rows[i].y);
+    }
+    if (valid < rows.size()) {
+        truncateRows(before);
+        throw std::out_of_range("NPC coordinates out of bounds: " + std::string(rows[valid].name) +
+                                " (batch row " + std::to_string(valid) + ")");
+    }
+}
+
+// откат пакета: удаление последних строк не переносит остальные
+void Arena::truncateRows(size_t size) {
+    while (store_.size() > size) {
+        const uint32_t last = static_cast<uint32_t>(store_.size() - 1);
+        index_.erase(store_.nameId()[last], store_.x()[last], store_.y()[last]);
+        store_.erase(last);
+    }
+}
+
+const NpcIndex& Arena::queryIndex() const {
+    if (!index_.built()) {
+        index_.build(store_, width_, height_);
+    }
+    return index_;
+}
+
+static NpcInfo infoOf(const NpcIndex::Entry& entry) {
+    return {entry.type, StringInterner::global().view(entry.nameId), entry.x, entry.y};
+}
+
+static void sortByName(std::vector<NpcInfo>& found) {
+    std::sort(found.begin(), found.end(), [](const NpcInfo& a, const NpcInfo& b) { return a.name < b.name; });
+}
+
+std::vector<NpcInfo> Arena::queryRadius(int x, int y, double radius) const {
+    std::vector<NpcInfo> found;
+    const int64_t maxD2 = maxSquaredDistance(radius);
+    if (maxD2 < 0) return found;
+
+    // описанный квадрат, обрезанный по арене
+    const double reach = std::min(radius, static_cast<double>(std::max(width_, height_)) * 2.0);
+    const int side = static_cast<int>(std::ceil(reach));
+    const int x0 = static_cast<int>(std::max<int64_t>(int64_t{x} - side, 0));
+    const int y0 = static_cast<int>(std::max<int64_t>(int64_t{y} - side, 0));
+    const int x1 = static_cast<int>(std::min<int64_t>(int64_t{x} + side, width_));
+    const int y1 = static_cast<int>(std::min<int64_t>(int64_t{y} + side, height_));
+    queryIndex().forEachInRect(x0, y0, x1, y1, [&](const NpcIndex::Entry& entry) {
+        const int64_t dx = static_cast<int64_t>(entry.x) - x;
+        const int64_t dy = static_cast<int64_t>(entry.y) - y;
+        if (dx * dx + dy * dy <= maxD2) found.push_back(infoOf(entry));
+    });
+    sortByName(found);
+    return found;
+}
+
+std::vector<NpcInfo> Arena::queryRect(int x0, int y0, int x1, int y1) const {
+    std::vector<NpcInfo> found;
+    queryIndex().forEachInRect(std::max(x0, 0), std::max(y0, 0), std::min(x1, width_), std::min(y1, height_),
+                               [&](const NpcIndex::Entry& entry) { found.push_back(infoOf(entry)); });
+    sortByName(found);
+    return found;
+}
+
+std::vector<NpcInfo> Arena::kNearest(int x, int y, size_t k) const {
+    std::vector<NpcInfo> found;
+    for (const auto& entry : queryIndex().nearest(x, y, k, nullptr)) found.push_back(infoOf(entry));
+    return found;
+}
+
+std::vector<NpcInfo> Arena::kNearest(int x, int y, size_t k, NpcType type) const {
+    std::vector<NpcInfo> found;
+    for (const auto& entry : queryIndex().nearest(x, y, k, &type)) found.push_back(infoOf(entry));
+    return found;
 }
 
 // вывод всех NPC, находящихся на арене
 void Arena::printAllNpcs() const {
-    for (const auto& pair : npcs_) {
-        std::cout << *(pair.second) << std::endl;
+    const auto& xs = store_.x();
+    const auto& ys = store_.y();
+    for (uint32_t row : rowsByName()) {
+        std::cout << "NPC [" << npcTypeName(store_.typeId()[row]) << "] " << store_.name(row)
+                  << " @ (" << xs[row] << ", " << ys[row] << ")" << std::endl;
     }
 }
 
 // возврат текущего количества NPC
 size_t Arena::getNpcCount() const {
-    return npcs_.size();
+    return store_.size();
 }
 
 // сохранение NPC в файл
 void Arena::saveToFile(const std::string& filename) const {
+    saveToFile(filename, SnapshotFormat::Text);
+}
+
+void Arena::saveToFile(const std::string& filename, SnapshotFormat format) const {
+    if (format == SnapshotFormat::Binary) {
+        writeBinarySnapshot(filename, store_, rowsByName());
+        return;
+    }
+
     std::ofstream file(filename);
     if (!file.is_open()) {
         throw std::runtime_error("Cannot open file for writing: " + filename);
     }
 
-    for (const auto& [name, npc] : npcs_) {
-        file << npc->getType() << " "
-             << npc->getName() << " "
-             << npc->getX() << " "
-             << npc->getY() << std::endl;
+    const auto& xs = store_.x();
+    const auto& ys = store_.y();
+    for (uint32_t row : rowsByName()) {
+        file << npcTypeName(store_.typeId()[row]) << " "
+             << store_.name(row) << " "
+             << xs[row] << " "
+             << ys[row] << std::endl;
     }
 }
 
 // загрузка NPC из файла
 void Arena::loadFromFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open file for reading: " + filename);
+    loadFromFile(filename, SnapshotFormat::Auto);
+}
+
+void Arena::loadFromFile(const std::string& filename, SnapshotFormat format) {
+    loadFromFile(filename, format, ExecutionPolicy::Sequential);
+}
+
+void Arena::loadFromFile(const std::string& filename, SnapshotFormat format, ExecutionPolicy policy) {
+    // строки до ошибки остаются в арене, поэтому версия публикуется и при исключении
+    struct PublishOnExit {
+        Arena& arena;
+        ~PublishOnExit() { arena.publishSnapshot(); }
+    } publish{*this};
+    ARENA_STATS_ONLY(StatTimer loadTimer(stats_.loadMs); const size_t before = store_.size();)
+    [[maybe_unused]] size_t bytes = 0;
+
+    if (format == SnapshotFormat::Auto) {
+        format = detectSnapshotFormat(filename);
+    }
+    if (format == SnapshotFormat::Binary) {
+        // столбцы читаются прямо из отображения, без разбора строк
+        MappedSnapshot snapshot(filename);
+        bytes = snapshot.bytes();
+        store_.reserve(store_.size() + snapshot.size());
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            addRow(snapshot.name(i), snapshot.type(i), snapshot.x(i), snapshot.y(i));
+        }
+    } else {
+        // разбор строк прямо в отображении файла, без промежуточных строк и объектов
+        MappedFile file(filename);
+        bytes = file.size();
+        if (policy == ExecutionPolicy::Parallel) {
+            loadTextParallel(file.view());
+        } else {
+            forEachNpcLine(file.view(), [this](const ParsedNpc& npc) {
+                addRow(npc.name, npc.type, npc.x, npc.y);
+            });
+        }
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
+    ARENA_STATS_ONLY(
+        ++stats_.loads;
+        stats_.npcsLoaded += store_.size() - before;
+        stats_.bytesLoaded += bytes;
+    )
+}
+
+// минимальный размер куска файла при параллельной загрузке
+static const size_t LOAD_CHUNK_BYTES = 64 * 1024;
+
+// разобранный кусок файла: строки до первой ошибки и сама ошибка
+struct LoadedChunk {
+    std::vector<ParsedNpc> rows;
+    std::vector<uint32_t> nameIds;
+    std::exception_ptr error;
+};
 
-        auto npc = NpcFactory::createFromString(line);
-        addNpc(std::move(npc));
+// ошибки те же и в том же порядке, что при построчной загрузке: строки до первой
+// ошибки (разбора, границ или повтора имени) добавляются, дальше - исключение
+void Arena::loadTextParallel(std::string_view text) {
+    ThreadPool& threads = pool();
+    const size_t chunkBytes = std::max(LOAD_CHUNK_BYTES, text.size() / (threads.size() * 4) + 1);
+    const std::vector<std::string_view> pieces = splitNpcText(text, chunkBytes);
+    std::vector<LoadedChunk> chunks(pieces.size());
+
+    threads.parallelFor(pieces.size(), 1, [&](size_t, size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            LoadedChunk& chunk = chunks[c];
+            try {
+                forEachNpcLine(pieces[c], [&](const ParsedNpc& npc) {
+                    if (npc.x < 0 || npc.x > width_ || npc.y < 0 || npc.y > height_) {
+                        throw std::out_of_range("NPC coordinates out of bounds.");
+                    }
+                    chunk.rows.push_back(npc);
+                    chunk.nameIds.push_back(StringInterner::global().intern(npc.name));
+                });
+            } catch (...) {
+                chunk.error = std::current_exception();
+            }
+        }
+    });
+
+    // слияние в порядке файла: повторы имён ищутся и внутри файла, и среди уже загруженных
+    size_t total = 0;
+    for (const auto& chunk : chunks) total += chunk.rows.size();
+    store_.reserve(store_.size() + total);
+
+    for (const auto& chunk : chunks) {
+        for (size_t i = 0; i < chunk.rows.size(); ++i) {
+            if (store_.find(chunk.nameIds[i]) != NpcStore::npos) {
+                throw std::invalid_argument("NPC with this name already exists.");
+            }
+            const ParsedNpc& npc = chunk.rows[i];
+            store_.insert(chunk.nameIds[i], npc.type, npc.x, npc.y);
+            index_.insert(chunk.nameIds[i], npc.type, npc.x, npc.y);
+            dirty_.push_back(chunk.nameIds[i]);
+        }
+        if (chunk.error) {
+            std::rethrow_exception(chunk.error);
+        }
     }
 }
 
 // очистка арены
 void Arena::clear() {
-    npcs_.clear();
+    store_.clear();
+    index_.invalidate();
+    dirty_.clear();
+    settledRange_ = std::numeric_limits<double>::infinity();
+    publishSnapshot();
+    // блоки пула отдаются целиком, если все объекты уже вернулись
+    if (npcPool_.live() == 0) {
+        npcPool_.clear();
+    }
+}
+
+NpcPool& Arena::npcPool() {
+    return npcPool_;
+}
+
+void Arena::enableSnapshots() {
+    publishing_ = true;
+    publishSnapshot();
+}
+
+SnapshotPublisher::ReadGuard Arena::readSnapshot() const {
+    return snapshots_.read();
+}
+
+// буфер берётся у издателя: при отсутствии долгих читателей это один из двух
+// прежних снимков, и его столбцы заполняются без новых выделений памяти
+void Arena::publishSnapshot() {
+    if (!publishing_) return;
+    snapshotRows_.assign(store_);
+    sendSnapshot();
+}
+
+void Arena::publishAppended(size_t from) {
+    if (!publishing_) return;
+    // большой пакет дешевле собрать целиком, чем добавлять по строке
+    if (snapshotRows_.size() != from || (store_.size() - from) * 2 > store_.size()) {
+        publishSnapshot();
+        return;
+    }
+    for (size_t row = from; row < store_.size(); ++row) {
+        snapshotRows_.push_back({store_.typeId()[row], store_.nameId()[row], store_.x()[row], store_.y()[row]});
+    }
+    sendSnapshot();
+}
+
+void Arena::publishMoved(uint32_t row) {
+    if (!publishing_) return;
+    snapshotRows_.set(row, {store_.typeId()[row], store_.nameId()[row], store_.x()[row], store_.y()[row]});
+    sendSnapshot();
+}
+
+void Arena::sendSnapshot() {
+    std::unique_ptr<ArenaSnapshot> snapshot = snapshots_.acquire();
+    snapshot->tick = tick_;
+    snapshot->width = width_;
+    snapshot->height = height_;
+    snapshot->rows = snapshotRows_;
+    snapshot->stats = stats_;
+    snapshots_.publish(std::move(snapshot));
+}
+
+ArenaStats Arena::getStats() const {
+    return stats_;
+}
+
+void Arena::resetStats() {
+    stats_ = ArenaStats{};
+}
+
+void Arena::dumpStats(const std::string& filename) const {
+    writePrometheusStats(stats_, filename);
 }
 
 // управление наблюдателями
 void Arena::addObserver(std::shared_ptr<Observer> observer) {
     observers_.push_back(observer);
+    if (bus_) bus_->setObservers(observers_);
 }
 
 void Arena::removeObserver(std::shared_ptr<Observer> observer) {
@@ -99,62 +470,512 @@ void Arena::removeObserver(std::shared_ptr<Observer> observer) {
         std::remove(observers_.begin(), observers_.end(), observer),
         observers_.end()
     );
+    if (bus_) bus_->setObservers(observers_);
+}
+
+void Arena::enableAsyncEvents(EventBus::Config config) {
+    disableAsyncEvents();
+    bus_ = std::make_unique<EventBus>(config);
+    bus_->setObservers(observers_);
 }
 
-// уведомление всех наблюдателей
-void Arena::notifyObservers(const std::string& event) {
+void Arena::disableAsyncEvents() {
+    if (!bus_) return;
+    bus_->flush();
+    bus_.reset();
+}
+
+void Arena::flushEvents() {
+    if (bus_) {
+        bus_->flush();
+        return;
+    }
+    for (auto& observer : observers_) {
+        observer->flush();
+    }
+}
+
+// уведомление всех наблюдателей (или постановка в очередь шины)
+void Arena::notifyObservers(const CombatEvent& event) {
+    if (bus_) {
+        bus_->publish(event);
+        return;
+    }
     for (auto& observer : observers_) {
         observer->notify(event);
     }
 }
 
-// боевая система: проверка всех пар NPC в пределах дальности
+std::vector<uint32_t> Arena::rowsByName() const {
+    std::vector<uint32_t> rows(store_.size());
+    for (uint32_t i = 0; i < rows.size(); ++i) rows[i] = i;
+    std::sort(rows.begin(), rows.end(), [this](uint32_t a, uint32_t b) {
+        return store_.name(a) < store_.name(b);
+    });
+    return rows;
+}
+
+// исход боя пары
+enum class Outcome : uint8_t { FirstKills, SecondKills, Mutual };
+
+struct Arena::Kill {
+    uint32_t first;
+    uint32_t second;
+    Outcome outcome;
+};
+
+// минимальное число NPC на одну задачу пула
+static const size_t BATTLE_GRAIN = 1024;
+
+void Arena::setThreadCount(size_t count) {
+    threadCount_ = count;
+    pool_.reset();
+}
+
+ThreadPool& Arena::pool() {
+    if (!pool_) {
+        pool_ = std::make_unique<ThreadPool>(
+            threadCount_ ? threadCount_ : std::thread::hardware_concurrency());
+    }
+    return *pool_;
+}
+
 void Arena::startBattle(double range) {
-    CombatVisitor visitor;
-    std::vector<std::string> toRemove;
-
-    // проверка каждой пары NPC
-    for (auto& [name1, npc1] : npcs_) {
-        for (auto& [name2, npc2] : npcs_) {
-            if (name1 == name2) continue;
-            if (name1 > name2) continue; // избегаем дублирования пар
-
-            // проверка, находятся ли в пределах дальности боя
-            if (npc1->distanceTo(*npc2) > range) continue;
-            
+    startBattle(range, BattleOptions{});
+}
+
+void Arena::startBattle(double range, ExecutionPolicy policy) {
+    BattleOptions options;
+    options.policy = policy;
+    startBattle(range, options);
+}
+
+// боевая система: поиск пар NPC в пределах дальности через пространственную сетку
+void Arena::startBattle(double range, const BattleOptions& options) {
+    if (!(range >= 0.0)) return;
+    ARENA_STATS_ONLY(StatTimer battleTimer(stats_.battleMs); ++stats_.battles;)
+
+    const uint32_t count = static_cast<uint32_t>(store_.size());
+
+    ARENA_STATS_ONLY(StatTimer gridTimer(stats_.gridMs);)
+    const bool sharded = layoutForBattle(range);
+    ARENA_STATS_ONLY(gridTimer.stop();)
+
+    auto fullKills = [&]() {
+        return scanKills(range, options.policy, sharded);
+    };
+
+    // после боя с дальностью settledRange_ среди выживших не осталось пар, способных
+    // сражаться на этой дальности: при меньшей или равной дальности бои возможны
+    // только в парах с NPC, добавленными или сдвинутыми после него
+    ARENA_STATS_ONLY(StatTimer scanTimer(stats_.scanMs);)
+    std::vector<Kill> kills;
+    if ((options.incremental || options.verify) && range <= settledRange_ && !sharded) {
+        std::vector<uint8_t> isDirty(count, 0);
+        std::vector<uint32_t> rows;
+        for (uint32_t nameId : dirty_) {
+            const uint32_t row = store_.find(nameId);
+            if (row != NpcStore::npos && !isDirty[row]) {
+                isDirty[row] = 1;
+                rows.push_back(row);
+            }
+        }
+
+        kills = gatherKills(rows.size(), options.policy, BATTLE_GRAIN, [&](size_t begin, size_t end, std::vector<Kill>& out) {
+            collectDirtyKills(range, rows, begin, end, isDirty, out);
+        });
+
+        if (options.verify) {
+            std::vector<Kill> expected = fullKills();
+            auto byRows = [](const Kill& a, const Kill& b) {
+                return a.first != b.first ? a.first < b.first : a.second < b.second;
+            };
+            auto same = [](const Kill& a, const Kill& b) {
+                return a.first == b.first && a.second == b.second && a.outcome == b.outcome;
+            };
+            std::sort(kills.begin(), kills.end(), byRows);
+            std::sort(expected.begin(), expected.end(), byRows);
+            if (!std::equal(kills.begin(), kills.end(), expected.begin(), expected.end(), same)) {
+                clearTypeGrids();
+                shards_.clear();
+                throw std::logic_error("Incremental battle differs from full recompute.");
+            }
+        }
+    } else {
+        kills = fullKills();
+    }
+    clearTypeGrids();
+    shards_.clear();
+    ARENA_STATS_ONLY(scanTimer.stop();)
+
+    dirty_.clear();
+    settledRange_ = range;
+    resolveKills(kills);
+    publishSnapshot();
+}
+
+#ifdef ARENA_ENABLE_STATS
+// приращение счётчиков текущего потока с момента before
+static ScanCounters scanDelta(const ScanCounters& before) {
+    const ScanCounters& now = threadScanCounters();
+    return {now.pairsExamined - before.pairsExamined, now.pairsInRange - before.pairsInRange};
+}
+#endif
+
+// большая карта делится на плитки, только если одна сетка на неё вышла бы
+// грубее дальности: иначе в соседних ячейках оказалось бы слишком много лишних NPC
+bool Arena::layoutForBattle(double range) {
+    const uint32_t count = static_cast<uint32_t>(store_.size());
+    if (ShardedGrid::needed(width_, height_, range)) {
+        shards_.build(store_.x().data(), store_.y().data(), count, range);
+        return true;
+    }
+    resetTypeGrids(range);
+    buildTypeGrids();
+    return false;
+}
+
+void Arena::resetTypeGrids(double range) {
+    for (auto& grid : typeGrids_) grid.reset(width_, height_, range);
+}
+
+// NPC типов, которые ни с кем не сражаются, в сетки не попадают
+void Arena::buildTypeGrids() {
+    static constexpr auto fights = [] {
+        std::array<bool, NPC_TYPE_COUNT> result{};
+        for (size_t a = 0; a < NPC_TYPE_COUNT; ++a) {
+            for (size_t b = 0; b < NPC_TYPE_COUNT; ++b) {
+                result[a] = result[a] || CombatVisitor::canFight(static_cast<NpcType>(a), static_cast<NpcType>(b));
+            }
+        }
+        return result;
+    }();
+
+    const auto& xs = store_.x();
+    const auto& ys = store_.y();
+    const auto& types = store_.typeId();
+    const uint32_t count = static_cast<uint32_t>(store_.size());
+    for (uint32_t row = 0; row < count; ++row) {
+        const size_t type = npcTypeIndex(types[row]);
+        if (fights[type]) typeGrids_[type].insert(row, xs[row], ys[row]);
+    }
+    for (auto& grid : typeGrids_) grid.build();
+}
+
+void Arena::clearTypeGrids() {
+    for (auto& grid : typeGrids_) grid.clear();
+}
+
+std::vector<Arena::Kill> Arena::scanKills(double range, ExecutionPolicy policy, bool sharded) {
+    if (sharded) {
+        // плиток немного, и каждая - крупная задача
+        return gatherKills(shards_.shardCount(), policy, 1, [&](size_t begin, size_t end, std::vector<Kill>& out) {
+            collectShardKills(range, begin, end, out);
+        });
+    }
+    const size_t cells = typeGrids_[0].cellCount() * NPC_TYPE_COUNT;
+    return gatherKills(cells, policy, BATTLE_GRAIN, [&](size_t begin, size_t end, std::vector<Kill>& out) {
+        collectKills(range, begin, end, out);
+    });
+}
+
+// у каждого блока свой буфер, слияние идёт в порядке блоков
+std::vector<Arena::Kill> Arena::gatherKills(
+    size_t count, ExecutionPolicy policy, size_t minGrain,
+    const std::function<void(size_t begin, size_t end, std::vector<Kill>& out)>& collect) {
+    std::vector<Kill> kills;
+    if (policy == ExecutionPolicy::Parallel && count > minGrain) {
+        ThreadPool& threads = pool();
+        const size_t grain = std::max<size_t>(minGrain, count / (threads.size() * 8) + 1);
+        std::vector<std::vector<Kill>> buffers(ThreadPool::chunkCount(count, grain));
+        ARENA_STATS_ONLY(std::vector<ScanCounters> counters(buffers.size());)
+        threads.parallelFor(count, grain, [&](size_t chunk, size_t begin, size_t end) {
+            ARENA_STATS_ONLY(const ScanCounters before = threadScanCounters();)
+            collect(begin, end, buffers[chunk]);
+            ARENA_STATS_ONLY(counters[chunk] = scanDelta(before);)
+        });
+        for (auto& buffer : buffers) {
+            kills.insert(kills.end(), buffer.begin(), buffer.end());
+        }
+        ARENA_STATS_ONLY(
+            for (const auto& delta : counters) {
+                stats_.pairsExamined += delta.pairsExamined;
+                stats_.pairsInRange += delta.pairsInRange;
+            }
+        )
+    } else {
+        ARENA_STATS_ONLY(const ScanCounters before = threadScanCounters();)
+        collect(0, count, kills);
+        ARENA_STATS_ONLY(
+            const ScanCounters delta = scanDelta(before);
+            stats_.pairsExamined += delta.pairsExamined;
+            stats_.pairsInRange += delta.pairsInRange;
+        )
+    }
+    return kills;
+}
+
+// наибольший блок соседних ячеек среди сеток по типам
+static size_t maxBlockOf(const std::array<SpatialGrid, NPC_TYPE_COUNT>& grids) {
+    size_t block = 0;
+    for (const auto& grid : grids) block = std::max(block, grid.maxCellSize());
+    return block;
+}
+
+// NPC перебираются по ячейкам, а не по строкам хранилища: у соседних NPC
+// общие соседние ячейки, и они не вытесняются из кеша между проверками.
+// Пару типов a <= b проверяет NPC типа a по сетке типа b, поэтому каждая
+// пара разных типов видна один раз
+void Arena::collectKills(double range, size_t begin, size_t end, std::vector<Kill>& out) const {
+    // пакетная проверка дальности по квадрату расстояния без sqrt
+    const int64_t maxD2 = maxSquaredDistance(range);
+    std::vector<uint32_t> inRange(maxBlockOf(typeGrids_));
+    const size_t cells = typeGrids_[0].cellCount();
+    for (size_t a = begin / cells; a < NPC_TYPE_COUNT && a * cells < end; ++a) {
+        const size_t from = std::max(begin, a * cells) - a * cells;
+        const size_t to = std::min(end, (a + 1) * cells) - a * cells;
+        typeGrids_[a].forEachCell(from, to, [&](const int* xs, const int* ys, const uint32_t* ids, size_t count) {
+            for (size_t b = a; b < NPC_TYPE_COUNT; ++b) {
+                if (!CombatVisitor::canFight(static_cast<NpcType>(a), static_cast<NpcType>(b))) continue;
+                for (size_t k = 0; k < count; ++k) {
+                    collectRowKills(typeGrids_[b], ids[k], xs[k], ys[k], maxD2, nullptr, a == b, inRange, out);
+                }
+            }
+        });
+    }
+}
+
+// пары, где оба NPC из плитки, находит только она; пары через границу видят обе
+// плитки (соседний NPC есть в ореоле), но берёт их, как и везде, меньший номер строки
+void Arena::collectShardKills(double range, size_t shardBegin, size_t shardEnd, std::vector<Kill>& out) const {
+    const int64_t maxD2 = maxSquaredDistance(range);
+    SpatialGrid grid;
+    std::vector<uint32_t> own;
+    std::vector<uint32_t> inRange;
+    const auto& xs = store_.x();
+    const auto& ys = store_.y();
+    for (size_t shard = shardBegin; shard < shardEnd; ++shard) {
+        const ShardedGrid::Offset offset = shards_.buildShard(shard, grid, own);
+        inRange.resize(grid.maxCellSize());
+        for (uint32_t row : own) {
+            collectRowKills(grid, row, xs[row] - offset.x, ys[row] - offset.y, maxD2, nullptr, true, inRange, out);
+        }
+    }
+}
+
+void Arena::collectDirtyKills(double range, const std::vector<uint32_t>& rows, size_t begin, size_t end,
+                              const std::vector<uint8_t>& isDirty, std::vector<Kill>& out) const {
+    const int64_t maxD2 = maxSquaredDistance(range);
+    std::vector<uint32_t> inRange(maxBlockOf(typeGrids_));
+    const auto& types = store_.typeId();
+    for (size_t k = begin; k < end; ++k) {
+        const uint32_t row = rows[k];
+        for (size_t b = 0; b < NPC_TYPE_COUNT; ++b) {
+            if (!CombatVisitor::canFight(types[row], static_cast<NpcType>(b))) continue;
+            collectRowKills(typeGrids_[b], row, store_.x()[row], store_.y()[row], maxD2, &isDirty,
+                            npcTypeIndex(types[row]) == b, inRange, out);
+        }
+    }
+}
+
+// проверка пар строки i только среди соседних ячеек
+void Arena::collectRowKills(const SpatialGrid& grid, uint32_t i, int x, int y, int64_t maxD2,
+                            const std::vector<uint8_t>* isDirty, bool ownGrid,
+                            std::vector<uint32_t>& inRange, std::vector<Kill>& out) const {
+    const auto& types = store_.typeId();
+    ARENA_STATS_ONLY(ScanCounters& counters = threadScanCounters();)
+
+    grid.forEachNeighbourCell(x, y, [&](const int* cellXs, const int* cellYs,
+                                         const uint32_t* ids, size_t count) {
+        const size_t found = selectInRange(x, y, cellXs, cellYs, count, maxD2, inRange.data());
+        ARENA_STATS_ONLY(counters.pairsExamined += count; counters.pairsInRange += found;)
+        for (size_t k = 0; k < found; ++k) {
+            const uint32_t j = ids[inRange[k]];
+            // избегаем дублирования пар: при полном переборе пару берёт меньший номер
+            // (пары разных типов проверяются только с одной стороны), при инкрементальном -
+            // изменённый NPC, а из двух изменённых меньший номер
+            if (j == i) continue;
+            if ((isDirty ? (*isDirty)[j] != 0 : ownGrid) && j < i) continue;
+
             // проверка боя в обоих направлениях
-            bool npc1KillsNpc2 = visitor.canKill(npc1.get(), npc2.get());
-            bool npc2KillsNpc1 = visitor.canKill(npc2.get(), npc1.get());
-            
-            if (npc1KillsNpc2 && npc2KillsNpc1) {
-                // взаимное убийство
-                std::string event = npc1->getName() + " (" + npc1->getType() + 
-                                   ") and " + npc2->getName() + " (" + npc2->getType() + 
-                                   ") killed each other";
-                notifyObservers(event);
-                toRemove.push_back(name1);
-                toRemove.push_back(name2);
-            } else if (npc1KillsNpc2) {
-                // только npc1 убивает npc2
-                std::string event = npc1->getName() + " (" + npc1->getType() + 
-                                   ") killed " + npc2->getName() + " (" + npc2->getType() + ")";
-                notifyObservers(event);
-                toRemove.push_back(name2);
-            } else if (npc2KillsNpc1) {
-                // только npc2 убивает npc1
-                std::string event = npc2->getName() + " (" + npc2->getType() + 
-                                   ") killed " + npc1->getName() + " (" + npc1->getType() + ")";
-                notifyObservers(event);
-                toRemove.push_back(name1);
+            const bool iKillsJ = CombatVisitor::canKill(types[i], types[j]);
+            const bool jKillsI = CombatVisitor::canKill(types[j], types[i]);
+            if (!iKillsJ && !jKillsI) continue;
+
+            Outcome outcome = iKillsJ && jKillsI ? Outcome::Mutual
+                            : iKillsJ ? Outcome::FirstKills : Outcome::SecondKills;
+            if (store_.name(i) < store_.name(j)) {
+                out.push_back({i, j, outcome});
+            } else {
+                if (outcome != Outcome::Mutual) {
+                    outcome = outcome == Outcome::FirstKills ? Outcome::SecondKills : Outcome::FirstKills;
+                }
+                out.push_back({j, i, outcome});
             }
         }
+    });
+}
+
+void Arena::resolveKills(std::vector<Kill>& kills) {
+    const auto& types = store_.typeId();
+    ARENA_STATS_ONLY(StatTimer resolveTimer(stats_.resolveMs); stats_.kills += kills.size();)
+
+    // события идут в порядке имён, как при полном переборе
+    std::sort(kills.begin(), kills.end(), [this](const Kill& a, const Kill& b) {
+        if (a.first != b.first) return store_.name(a.first) < store_.name(b.first);
+        return store_.name(a.second) < store_.name(b.second);
+    });
+
+    const auto& xs = store_.x();
+    const auto& ys = store_.y();
+    const auto& names = store_.nameId();
+    const uint64_t tick = tick_++;
+    ARENA_STATS_ONLY(resolveTimer.stop(); StatTimer dispatchTimer(stats_.dispatchMs);)
+
+    // события - записи фиксированного размера, текст собирают только печатающие наблюдатели
+    // погибшие отмечаются в битовой маске по номерам строк, повторы ничего не стоят
+    std::vector<uint64_t> dead(kills.empty() ? 0 : (store_.size() + 63) / 64, 0);
+    auto markDead = [&dead](uint32_t row) { dead[row / 64] |= uint64_t{1} << (row % 64); };
+    for (const Kill& kill : kills) {
+        uint32_t attacker = kill.first;
+        uint32_t defender = kill.second;
+        CombatEventKind kind = CombatEventKind::Kill;
+
+        if (kill.outcome == Outcome::Mutual) {
+            // взаимное убийство
+            kind = CombatEventKind::MutualKill;
+            markDead(attacker);
+        } else if (kill.outcome == Outcome::SecondKills) {
+            std::swap(attacker, defender);
+        }
+        markDead(defender);
+
+        notifyObservers(CombatEvent{kind, types[attacker], types[defender],
+                                    names[attacker], names[defender],
+                                    xs[defender], ys[defender], tick});
     }
-    
-    // удаление мёртвых NPC (сначала устраняем дубликаты)
-    std::sort(toRemove.begin(), toRemove.end());
-    toRemove.erase(std::unique(toRemove.begin(), toRemove.end()), toRemove.end());
-    
-    for (const auto& name : toRemove) {
-        npcs_.erase(name);
+
+    // конец пачки: синхронные наблюдатели сбрасывают буферы сразу,
+    // асинхронная шина делает это сама после каждой доставленной пачки
+    if (!bus_ && !kills.empty()) {
+        flushEvents();
+    }
+    ARENA_STATS_ONLY(dispatchTimer.stop(); stats_.eventsDispatched += kills.size();)
+    ARENA_STATS_ONLY(StatTimer removalTimer(stats_.removalMs);)
+
+    // удаление мёртвых NPC одним проходом по маске
+    index_.eraseMarked(dead, store_);
+    [[maybe_unused]] const size_t removed = store_.eraseMarked(dead);
+    ARENA_STATS_ONLY(stats_.removed += removed;)
+}
+
+StreamingReport Arena::startStreamingBattle(const std::string& input, const std::string& output,
+                                            double range, const StreamingOptions& options) {
+    const StreamingReport report = streamingBattle(input, output, range, width_, height_, options,
+                                                   [this](const CombatEvent& event) { notifyObservers(event); },
+                                                   tick_++);
+    if (!bus_ && report.kills > 0) {
+        flushEvents();
+    }
+    return report;
+}
+
+SimulationReport Arena::simulate(size_t ticks, double range, const MovePolicy& move) {
+    return simulate(ticks, range, move, ExecutionPolicy::Sequential);
+}
+
+// смещение зависит от зерна, хода и имени, но не от номера строки
+static uint64_t moveHash(uint64_t seed, uint64_t tick, uint32_t nameId) {
+    uint64_t z = seed + tick * 0x9E3779B97F4A7C15ull + nameId * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+SimulationReport Arena::simulate(size_t ticks, double range, const MovePolicy& move,
+                                 ExecutionPolicy policy) {
+    using Clock = std::chrono::steady_clock;
+    auto elapsedMs = [](Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    };
+
+    if (move.maxStep < 0) {
+        throw std::invalid_argument("MovePolicy::maxStep must not be negative.");
     }
-}
\ No newline at end of file
+    SimulationReport report;
+    // как и в startBattle, отрицательная дальность (или NaN) - ходы без боёв
+    const bool fights = range >= 0.0;
+    report.ticks.reserve(ticks);
+    const auto start = Clock::now();
+    // перемещения не попадают в список изменённых: до конца симуляции бои только полные
+    settledRange_ = -1.0;
+    // индекс запросов не сопровождает массовые перемещения, он строится заново при запросе
+    index_.invalidate();
+
+    const bool sharded = fights && ShardedGrid::needed(width_, height_, range);
+    if (fights && !sharded) resetTypeGrids(range);
+
+    // дальше края всё равно не уйти, а 2 * maxStep + 1 не должно переполниться
+    const int maxStep = std::min(move.maxStep, std::max(width_, height_));
+    const int span = 2 * maxStep + 1;
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        TickStats stats;
+        const auto moveStart = Clock::now();
+
+        const auto& names = store_.nameId();
+        const uint32_t count = static_cast<uint32_t>(store_.size());
+        for (uint32_t row = 0; row < count; ++row) {
+            const uint64_t h = moveHash(move.seed, tick, names[row]);
+            const int dx = static_cast<int>(h % span) - maxStep;
+            const int dy = static_cast<int>((h >> 32) % span) - maxStep;
+            if (dx == 0 && dy == 0) continue;
+            const int x = std::clamp(store_.x()[row] + dx, 0, width_);
+            const int y = std::clamp(store_.y()[row] + dy, 0, height_);
+            store_.move(row, x, y);
+        }
+
+        // сетка раскладывается заново в те же буферы: сортировка подсчётом
+        // дешевле поштучного переноса записей между ячейками
+        const auto gridStart = Clock::now();
+        if (!fights) {
+            stats.moveMs = elapsedMs(moveStart, gridStart);
+            stats.alive = store_.size();
+            report.ticks.push_back(stats);
+            publishSnapshot();
+            continue;
+        }
+        if (sharded) {
+            shards_.build(store_.x().data(), store_.y().data(), count, range);
+        } else {
+            buildTypeGrids();
+        }
+
+        const auto battleStart = Clock::now();
+        ARENA_STATS_ONLY(StatTimer scanTimer(stats_.scanMs);)
+        std::vector<Kill> kills = scanKills(range, policy, sharded);
+        ARENA_STATS_ONLY(scanTimer.stop();)
+        stats.kills = kills.size();
+        resolveKills(kills);
+
+        const auto tickEnd = Clock::now();
+        stats.moveMs = elapsedMs(moveStart, gridStart);
+        stats.gridMs = elapsedMs(gridStart, battleStart);
+        stats.battleMs = elapsedMs(battleStart, tickEnd);
+        stats.alive = store_.size();
+        ARENA_STATS_ONLY(
+            ++stats_.battles;
+            stats_.gridMs += stats.gridMs;
+            stats_.battleMs += stats.gridMs + stats.battleMs;
+        )
+        report.ticks.push_back(stats);
+        publishSnapshot();
+    }
+    clearTypeGrids();
+    shards_.clear();
+
+    // последний ход закончился полным боем на дальности range
+    dirty_.clear();
+    settledRange_ = fights && ticks > 0 ? range : -1.0;
+    report.totalMs = elapsedMs(start, Clock::now());
+    return report;
+}
@@ -0,0 +1,172 @@
+#include "../include/arena_snapshot.h"
+#include "../include/string_interner.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+// узел, который можно менять: новый или копия общего с опубликованными снимками
+SnapshotRows::Node& SnapshotRows::editable(std::shared_ptr<Node>& node) {
+    if (node && node.use_count() == 1) return *node;
+    auto copy = std::make_shared<Node>();
+    if (node) {
+        copy->children.reserve(WIDTH);
+        copy->children.assign(node->children.begin(), node->children.end());
+        copy->rows.reserve(WIDTH);
+        copy->rows.assign(node->rows.begin(), node->rows.end());
+    }
+    node = std::move(copy);
+    return *node;
+}
+
+// полная сборка снизу вверх: листья по WIDTH строк, затем уровни узлов
+void SnapshotRows::assign(const NpcStore& store) {
+    size_ = store.size();
+    shift_ = 0;
+    root_.reset();
+    if (size_ == 0) return;
+
+    const auto& types = store.typeId();
+    const auto& names = store.nameId();
+    const auto& xs = store.x();
+    const auto& ys = store.y();
+    std::vector<std::shared_ptr<Node>> level;
+    for (size_t begin = 0; begin < size_; begin += WIDTH) {
+        auto leaf = std::make_shared<Node>();
+        const size_t end = std::min(size_, begin + WIDTH);
+        leaf->rows.reserve(WIDTH);
+        for (size_t i = begin; i < end; ++i) {
+            leaf->rows.push_back({types[i], names[i], xs[i], ys[i]});
+        }
+        level.push_back(std::move(leaf));
+    }
+    while (level.size() > 1) {
+        std::vector<std::shared_ptr<Node>> parents;
+        for (size_t begin = 0; begin < level.size(); begin += WIDTH) {
+            auto parent = std::make_shared<Node>();
+            const size_t end = std::min(level.size(), begin + WIDTH);
+            parent->children.reserve(WIDTH);
+            for (size_t i = begin; i < end; ++i) parent->children.push_back(std::move(level[i]));
+            parents.push_back(std::move(parent));
+        }
+        level.swap(parents);
+        shift_ += BITS;
+    }
+    root_ = std::move(level.front());
+}
+
+void SnapshotRows::set(size_t i, const Row& row) {
+    Node* node = &editable(root_);
+    for (unsigned shift = shift_; shift > 0; shift -= BITS) {
+        node = &editable(node->children[(i >> shift) & MASK]);
+    }
+    node->rows[i & MASK] = row;
+}
+
+void SnapshotRows::push_back(const Row& row) {
+    // дерево заполнено - над корнем появляется новый уровень
+    if (root_ && size_ == (WIDTH << shift_)) {
+        auto top = std::make_shared<Node>();
+        top->children.reserve(WIDTH);
+        top->children.push_back(std::move(root_));
+        root_ = std::move(top);
+        shift_ += BITS;
+    }
+    Node* node = &editable(root_);
+    for (unsigned shift = shift_; shift > 0; shift -= BITS) {
+        const size_t k = (size_ >> shift) & MASK;
+        if (k == node->children.size()) node->children.emplace_back();
+        node = &editable(node->children[k]);
+    }
+    node->rows.push_back(row);
+    ++size_;
+}
+
+std::string_view ArenaSnapshot::name(size_t i) const {
+    return StringInterner::global().view(rows[i].nameId);
+}
+
+void ArenaSnapshot::print(std::ostream& out) const {
+    std::vector<SnapshotRows::Row> sorted;
+    sorted.reserve(size());
+    rows.forEach([&](const SnapshotRows::Row& row) { sorted.push_back(row); });
+    const StringInterner& interner = StringInterner::global();
+    std::sort(sorted.begin(), sorted.end(), [&](const SnapshotRows::Row& a, const SnapshotRows::Row& b) {
+        return interner.view(a.nameId) < interner.view(b.nameId);
+    });
+    for (const auto& row : sorted) {
+        out << "NPC [" << npcTypeName(row.type) << "] " << interner.view(row.nameId)
+            << " @ (" << row.x << ", " << row.y << ")\n";
+    }
+}
+
+SnapshotPublisher::SnapshotPublisher() : current_(new ArenaSnapshot()) {}
+
+SnapshotPublisher::~SnapshotPublisher() {
+    delete current_.load();
+}
+
+SnapshotPublisher::ReadGuard::ReadGuard(ReadGuard&& other) noexcept
+    : slot_(other.slot_), snapshot_(other.snapshot_) {
+    other.slot_ = nullptr;
+}
+
+SnapshotPublisher::ReadGuard::~ReadGuard() {
+    if (slot_) slot_->store(IDLE, std::memory_order_release);
+}
+
+// читатель занимает свободный слот, записывая в него эпоху, и только потом читает
+// указатель: снимок, заменённый после чтения эпохи, писатель не тронет, а заменённый
+// раньше читатель уже не увидит. Все операции seq_cst - порядок записи слота и
+// чтения указателя здесь и подмены и проверки слотов у писателя важен
+SnapshotPublisher::ReadGuard SnapshotPublisher::read() const {
+    // у потока свой стартовый слот, чтобы потоки не сталкивались на первых слотах
+    thread_local const size_t hint = std::hash<std::thread::id>{}(std::this_thread::get_id()) % MAX_READERS;
+    const uint64_t epoch = epoch_.load();
+    while (true) {
+        for (size_t k = 0; k < MAX_READERS; ++k) {
+            Slot& slot = slots_[(hint + k) % MAX_READERS];
+            uint64_t expected = IDLE;
+            if (slot.epoch.load(std::memory_order_relaxed) == IDLE &&
+                slot.epoch.compare_exchange_strong(expected, epoch)) {
+                return ReadGuard(&slot.epoch, current_.load());
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+std::unique_ptr<ArenaSnapshot> SnapshotPublisher::acquire() {
+    reclaim();
+    if (spares_.empty()) return std::make_unique<ArenaSnapshot>();
+    std::unique_ptr<ArenaSnapshot> snapshot = std::move(spares_.back());
+    spares_.pop_back();
+    return snapshot;
+}
+
+void SnapshotPublisher::publish(std::unique_ptr<ArenaSnapshot> snapshot) {
+    snapshot->version = nextVersion_++;
+    ArenaSnapshot* previous = current_.exchange(snapshot.release());
+    // читатели с эпохой не больше этой могли успеть прочитать previous
+    const uint64_t replacedAt = epoch_.fetch_add(1);
+    retired_.emplace_back(replacedAt, std::unique_ptr<ArenaSnapshot>(previous));
+    reclaim();
+}
+
+size_t SnapshotPublisher::retiredCount() const {
+    return retired_.size();
+}
+
+// заменённый снимок свободен, если все занятые слоты объявили эпоху позже его замены
+void SnapshotPublisher::reclaim() {
+    if (retired_.empty()) return;
+    uint64_t oldest = IDLE;
+    for (const Slot& slot : slots_) {
+        oldest = std::min(oldest, slot.epoch.load());
+    }
+    auto free = std::stable_partition(retired_.begin(), retired_.end(),
+                                      [oldest](const auto& entry) { return entry.first >= oldest; });
+    for (auto it = free; it != retired_.end(); ++it) {
+        if (spares_.size() < MAX_SPARES) spares_.push_back(std::move(it->second));
+    }
+    retired_.erase(free, retired_.end());
+}
@@ -0,0 +1,65 @@
+#include "../include/arena_stats.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+static void writeMetric(std::ostream& out, const char* name, const char* help, double value) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " counter\n"
+        << name << " " << value << "\n";
+}
+
+void writePrometheusStats(const ArenaStats& stats, std::ostream& out) {
+    const auto precision = out.precision(15);
+
+    writeMetric(out, "arena_battles_total", "Battles and simulation ticks resolved.",
+                static_cast<double>(stats.battles));
+    writeMetric(out, "arena_pairs_examined_total", "Candidate pairs taken from neighbouring grid cells.",
+                static_cast<double>(stats.pairsExamined));
+    writeMetric(out, "arena_pairs_in_range_total", "Candidate pairs within battle range.",
+                static_cast<double>(stats.pairsInRange));
+    writeMetric(out, "arena_kills_total", "Kills resolved, mutual kills counted once.",
+                static_cast<double>(stats.kills));
+    writeMetric(out, "arena_removed_total", "NPCs removed after battles.",
+                static_cast<double>(stats.removed));
+    writeMetric(out, "arena_events_dispatched_total", "Combat events passed to observers.",
+                static_cast<double>(stats.eventsDispatched));
+
+    out << "# HELP arena_phase_seconds_total Wall time spent in battle phases.\n"
+        << "# TYPE arena_phase_seconds_total counter\n";
+    const std::pair<const char*, double> phases[] = {
+        {"battle", stats.battleMs}, {"grid", stats.gridMs},         {"scan", stats.scanMs},
+        {"resolve", stats.resolveMs}, {"dispatch", stats.dispatchMs}, {"removal", stats.removalMs},
+        {"load", stats.loadMs},
+    };
+    for (const auto& [phase, ms] : phases) {
+        out << "arena_phase_seconds_total{phase=\"" << phase << "\"} " << ms / 1000.0 << "\n";
+    }
+
+    writeMetric(out, "arena_loads_total", "Files loaded.", static_cast<double>(stats.loads));
+    writeMetric(out, "arena_loaded_npcs_total", "NPCs added by file loads.",
+                static_cast<double>(stats.npcsLoaded));
+    writeMetric(out, "arena_loaded_bytes_total", "Bytes of NPC files loaded.",
+                static_cast<double>(stats.bytesLoaded));
+
+    out.precision(precision);
+}
+
+void writePrometheusStats(const ArenaStats& stats, const std::string& filename) {
+    const std::string temporary = filename + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open file for writing: " + temporary);
+        }
+        writePrometheusStats(stats, file);
+        if (!file) {
+            throw std::runtime_error("Cannot write to file: " + temporary);
+        }
+    }
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Cannot write to file: " + filename);
+    }
+}
@@ -0,0 +1,21 @@
+#include "../include/combat_event.h"
+#include "../include/string_interner.h"
+
+void formatEvent(const CombatEvent& event, std::string& out) {
+    const StringInterner& names = StringInterner::global();
+    out.clear();
+    out.append(names.view(event.attackerId));
+    out.append(" (");
+    out.append(npcTypeName(event.attackerType));
+    out.append(event.kind == CombatEventKind::MutualKill ? ") and " : ") killed ");
+    out.append(names.view(event.defenderId));
+    out.append(" (");
+    out.append(npcTypeName(event.defenderType));
+    out.append(event.kind == CombatEventKind::MutualKill ? ") killed each other" : ")");
+}
+
+std::string formatEvent(const CombatEvent& event) {
+    std::string out;
+    formatEvent(event, out);
+    return out;
+}
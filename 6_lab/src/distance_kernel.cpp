@@ -0,0 +1,169 @@
+#include "../include/distance_kernel.h"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DISTANCE_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+// квадраты разностей считаются в double: для координат до 2^26 они точны
+static size_t selectScalar(int x, int y, const int* xs, const int* ys, size_t count,
+                           double limit, uint32_t* out, size_t start) {
+    // запись без ветвлений: номер пишется всегда, счётчик растёт только при попадании
+    size_t found = 0;
+    for (size_t i = start; i < count; ++i) {
+        const double dx = static_cast<double>(x) - xs[i];
+        const double dy = static_cast<double>(y) - ys[i];
+        out[found] = static_cast<uint32_t>(i);
+        found += dx * dx + dy * dy <= limit;
+    }
+    return found;
+}
+
+#ifdef DISTANCE_KERNEL_X86
+
+// таблица упаковки: для каждой маски номера установленных битов подряд
+struct CompressTable {
+    uint32_t lanes[256][8];
+
+    CompressTable() : lanes{} {
+        for (unsigned mask = 0; mask < 256; ++mask) {
+            unsigned n = 0;
+            for (unsigned bit = 0; bit < 8; ++bit) {
+                if (mask & (1u << bit)) lanes[mask][n++] = bit;
+            }
+        }
+    }
+};
+
+static const CompressTable COMPRESS;
+
+// в блоке уже обработано не меньше найденного, поэтому запись полного блока
+// по адресу out + found не выходит за границу count
+
+__attribute__((target("sse2")))
+static size_t selectSse2(int x, int y, const int* xs, const int* ys, size_t count,
+                         double limit, uint32_t* out) {
+    const __m128i ax = _mm_set1_epi32(x);
+    const __m128i ay = _mm_set1_epi32(y);
+    const __m128d lim = _mm_set1_pd(limit);
+    size_t found = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i dx = _mm_sub_epi32(ax, _mm_loadu_si128(reinterpret_cast<const __m128i*>(xs + i)));
+        __m128i dy = _mm_sub_epi32(ay, _mm_loadu_si128(reinterpret_cast<const __m128i*>(ys + i)));
+
+        __m128d dxLo = _mm_cvtepi32_pd(dx);
+        __m128d dyLo = _mm_cvtepi32_pd(dy);
+        __m128d dxHi = _mm_cvtepi32_pd(_mm_shuffle_epi32(dx, _MM_SHUFFLE(1, 0, 3, 2)));
+        __m128d dyHi = _mm_cvtepi32_pd(_mm_shuffle_epi32(dy, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        __m128d lo = _mm_add_pd(_mm_mul_pd(dxLo, dxLo), _mm_mul_pd(dyLo, dyLo));
+        __m128d hi = _mm_add_pd(_mm_mul_pd(dxHi, dxHi), _mm_mul_pd(dyHi, dyHi));
+
+        unsigned mask = static_cast<unsigned>(_mm_movemask_pd(_mm_cmple_pd(lo, lim))) |
+                        (static_cast<unsigned>(_mm_movemask_pd(_mm_cmple_pd(hi, lim))) << 2);
+        __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(COMPRESS.lanes[mask]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + found),
+                         _mm_add_epi32(lanes, _mm_set1_epi32(static_cast<int>(i))));
+        found += __builtin_popcount(mask);
+    }
+    return found + selectScalar(x, y, xs, ys, count, limit, out + found, i);
+}
+
+__attribute__((target("avx2")))
+static size_t selectAvx2(int x, int y, const int* xs, const int* ys, size_t count,
+                         double limit, uint32_t* out) {
+    const __m256i ax = _mm256_set1_epi32(x);
+    const __m256i ay = _mm256_set1_epi32(y);
+    const __m256d lim = _mm256_set1_pd(limit);
+    size_t found = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i dx = _mm256_sub_epi32(ax, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i)));
+        __m256i dy = _mm256_sub_epi32(ay, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys + i)));
+
+        __m256d dxLo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(dx));
+        __m256d dyLo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(dy));
+        __m256d dxHi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(dx, 1));
+        __m256d dyHi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(dy, 1));
+
+        __m256d lo = _mm256_add_pd(_mm256_mul_pd(dxLo, dxLo), _mm256_mul_pd(dyLo, dyLo));
+        __m256d hi = _mm256_add_pd(_mm256_mul_pd(dxHi, dxHi), _mm256_mul_pd(dyHi, dyHi));
+
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(lo, lim, _CMP_LE_OQ))) |
+                        (static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(hi, lim, _CMP_LE_OQ))) << 4);
+        __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(COMPRESS.lanes[mask]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + found),
+                            _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(i))));
+        found += __builtin_popcount(mask);
+    }
+    return found + selectScalar(x, y, xs, ys, count, limit, out + found, i);
+}
+
+#endif
+
+KernelIsa detectKernelIsa() {
+#ifdef DISTANCE_KERNEL_X86
+    static const KernelIsa isa = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return KernelIsa::Avx2;
+        if (__builtin_cpu_supports("sse2")) return KernelIsa::Sse2;
+        return KernelIsa::Scalar;
+    }();
+    return isa;
+#else
+    return KernelIsa::Scalar;
+#endif
+}
+
+const char* kernelIsaName(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::Avx2: return "avx2";
+        case KernelIsa::Sse2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+int64_t maxSquaredDistance(double range) {
+    if (!(range >= 0.0)) return -1;
+
+    // за пределами 2^52 квадраты не различимы в double: в дальность входит всё
+    const double cap = 4503599627370496.0;
+    if (range * range >= cap) return INT64_MAX;
+
+    int64_t k = static_cast<int64_t>(std::floor(range * range));
+    // поправка на округление: граница совпадает с проверкой через sqrt
+    while (std::sqrt(static_cast<double>(k + 1)) <= range) ++k;
+    while (k >= 0 && std::sqrt(static_cast<double>(k)) > range) --k;
+    return k;
+}
+
+// векторный путь окупается начиная с одного полного блока
+static const size_t SIMD_MIN_COUNT = 8;
+
+size_t selectInRange(int x, int y, const int* xs, const int* ys, size_t count,
+                     int64_t maxD2, uint32_t* out) {
+    if (count < SIMD_MIN_COUNT) {
+        if (maxD2 < 0) return 0;
+        return selectScalar(x, y, xs, ys, count, static_cast<double>(maxD2), out, 0);
+    }
+    return selectInRange(x, y, xs, ys, count, maxD2, out, detectKernelIsa());
+}
+
+size_t selectInRange(int x, int y, const int* xs, const int* ys, size_t count,
+                     int64_t maxD2, uint32_t* out, KernelIsa isa) {
+    if (maxD2 < 0) return 0;
+    const double limit = static_cast<double>(maxD2);
+#ifdef DISTANCE_KERNEL_X86
+    if (isa == KernelIsa::Avx2 && detectKernelIsa() == KernelIsa::Avx2) {
+        return selectAvx2(x, y, xs, ys, count, limit, out);
+    }
+    if (isa != KernelIsa::Scalar && detectKernelIsa() != KernelIsa::Scalar) {
+        return selectSse2(x, y, xs, ys, count, limit, out);
+    }
+#else
+    (void)isa;
+#endif
+    return selectScalar(x, y, xs, ys, count, limit, out, 0);
+}
@@ -0,0 +1,168 @@
+#include "../include/event_bus.h"
+#include <chrono>
+
+EventBus::EventBus() : EventBus(Config{}) {}
+
+EventBus::EventBus(Config config) : config_(config) {
+    // ёмкость округляется до степени двойки, чтобы индекс брался маской
+    size_t capacity = 1;
+    while (capacity < config_.capacity) capacity <<= 1;
+    config_.capacity = capacity;
+    if (config_.batchSize == 0) config_.batchSize = 1;
+
+    ring_.resize(capacity);
+    mask_ = capacity - 1;
+    worker_ = std::thread(&EventBus::run, this);
+}
+
+EventBus::~EventBus() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping_ = true;
+    }
+    wakeUp_.notify_one();
+    worker_.join();
+}
+
+void EventBus::setObservers(std::vector<std::shared_ptr<Observer>> observers) {
+    flush();
+    std::lock_guard<std::mutex> lock(observersMutex_);
+    observers_.swap(observers);
+}
+
+void EventBus::publish(const CombatEvent& event) {
+    // пока дополнительная очередь не разобрана, события идут туда же, чтобы сохранить порядок
+    if (overflowActive_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(overflowMutex_);
+        if (overflowActive_.load(std::memory_order_relaxed)) {
+            overflow_.push_back(event);
+            publishedCount_.fetch_add(1, std::memory_order_relaxed);
+            wakeConsumer();
+            return;
+        }
+    }
+
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    while (tail - head_.load(std::memory_order_acquire) > mask_) {
+        if (config_.policy == BackPressure::Drop) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (config_.policy == BackPressure::Grow) {
+            std::lock_guard<std::mutex> lock(overflowMutex_);
+            overflow_.push_back(event);
+            overflowActive_.store(true, std::memory_order_release);
+            publishedCount_.fetch_add(1, std::memory_order_relaxed);
+            wakeConsumer();
+            return;
+        }
+        wakeConsumer();
+        std::this_thread::yield();
+    }
+
+    ring_[tail & mask_] = event;
+    tail_.store(tail + 1, std::memory_order_seq_cst);
+    publishedCount_.fetch_add(1, std::memory_order_relaxed);
+    wakeConsumer();
+}
+
+void EventBus::flush() {
+    const uint64_t target = publishedCount_.load(std::memory_order_relaxed);
+    {
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wakeUp_.notify_one();
+        delivered_.wait(lock, [&]() {
+            return deliveredCount_.load(std::memory_order_acquire) >= target;
+        });
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(observersMutex_);
+        std::swap(error, error_);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+size_t EventBus::dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+void EventBus::wakeConsumer() {
+    if (sleeping_.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakeUp_.notify_one();
+    }
+}
+
+// сначала кольцо, дополнительная очередь - только когда кольцо пусто
+size_t EventBus::takeBatch(std::vector<CombatEvent>& batch) {
+    batch.clear();
+    size_t head = head_.load(std::memory_order_relaxed);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    while (head != tail && batch.size() < config_.batchSize) {
+        batch.push_back(ring_[head & mask_]);
+        ++head;
+    }
+    head_.store(head, std::memory_order_release);
+    if (!batch.empty() || !overflowActive_.load(std::memory_order_acquire)) {
+        return batch.size();
+    }
+
+    std::lock_guard<std::mutex> lock(overflowMutex_);
+    if (head_.load(std::memory_order_relaxed) != tail_.load(std::memory_order_acquire)) {
+        return 0;
+    }
+    while (!overflow_.empty() && batch.size() < config_.batchSize) {
+        batch.push_back(overflow_.front());
+        overflow_.pop_front();
+    }
+    if (overflow_.empty()) {
+        overflowActive_.store(false, std::memory_order_release);
+    }
+    return batch.size();
+}
+
+void EventBus::deliver(std::vector<CombatEvent>& batch) {
+    std::lock_guard<std::mutex> lock(observersMutex_);
+    try {
+        for (const auto& event : batch) {
+            for (auto& observer : observers_) {
+                observer->notify(event);
+            }
+        }
+        for (auto& observer : observers_) {
+            observer->flush();
+        }
+    } catch (...) {
+        // ошибку наблюдателя получит следующий flush()
+        if (!error_) error_ = std::current_exception();
+    }
+
+    deliveredCount_.fetch_add(batch.size(), std::memory_order_release);
+    std::lock_guard<std::mutex> wakeLock(wakeMutex_);
+    delivered_.notify_all();
+}
+
+void EventBus::run() {
+    std::vector<CombatEvent> batch;
+    batch.reserve(config_.batchSize);
+    while (true) {
+        if (takeBatch(batch) != 0) {
+            deliver(batch);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        sleeping_.store(true, std::memory_order_seq_cst);
+        const bool hasWork = head_.load(std::memory_order_seq_cst) != tail_.load(std::memory_order_seq_cst) ||
+                             overflowActive_.load(std::memory_order_acquire);
+        if (!hasWork) {
+            if (stopping_) return;
+            wakeUp_.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
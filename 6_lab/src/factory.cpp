@@ -2,11 +2,9 @@
 #include "../include/knight.h"
 #include "../include/pegasus.h"
 #include "../include/squirrel.h"
-#include <sstream>
+#include "../include/npc_parser.h"
 #include <stdexcept>
 #include <memory>
-#include <map>
-#include <functional>
 
 std::unique_ptr<Npc> NpcFactory::createNpc(
     const std::string& type,
@@ -14,31 +12,40 @@ std::unique_ptr<Npc> NpcFactory::createNpc(
     int x,
     int y) {
     
-    // таблица создателей для разных типов NPC
-    static const std::map<std::string, std::function<std::unique_ptr<Npc>(int, int, const std::string&)>> creators = {
-        {"Knight", [](int x, int y, const std::string& n) { return std::make_unique<Knight>(x, y, n); }},
-        {"Squirrel", [](int x, int y, const std::string& n) { return std::make_unique<Squirrel>(x, y, n); }},
-        {"Pegasus", [](int x, int y, const std::string& n) { return std::make_unique<Pegasus>(x, y, n); }}
-    };
-    
-    auto it = creators.find(type);
-    if (it != creators.end()) {
-        return it->second(x, y, name);
+    // тип ищется по идеальному хешу имён
+    NpcType typeId;
+    if (parseNpcType(type, typeId)) {
+        return createNpc(typeId, name, x, y);
     }
     
     throw std::invalid_argument("Unknown NPC type: " + type);
 }
 
-std::unique_ptr<Npc> NpcFactory::createFromString(const std::string& line) {
-    std::istringstream iss(line);
-    std::string type, name;
-    int x, y;
+std::unique_ptr<Npc> NpcFactory::createNpc(NpcType type, const std::string& name, int x, int y) {
+    switch (type) {
+        case NpcType::Knight: return std::make_unique<Knight>(x, y, name);
+        case NpcType::Squirrel: return std::make_unique<Squirrel>(x, y, name);
+        case NpcType::Pegasus: return std::make_unique<Pegasus>(x, y, name);
+    }
+    throw std::invalid_argument("Unknown NPC type: " + std::string(npcTypeName(type)));
+}
 
-    iss >> type >> name >> x >> y;
-    
-    if (iss.fail()) {
-        throw std::runtime_error("Failed to read line: " + line);
+NpcPool::Ptr NpcFactory::createNpc(
+    NpcPool& pool,
+    const std::string& type,
+    const std::string& name,
+    int x,
+    int y) {
+
+    NpcType typeId;
+    if (parseNpcType(type, typeId)) {
+        return pool.create(typeId, name, x, y);
     }
 
-    return createNpc(type, name, x ,y);
-}
\ No newline at end of file
+    throw std::invalid_argument("Unknown NPC type: " + type);
+}
+
+std::unique_ptr<Npc> NpcFactory::createFromString(const std::string& line) {
+    const ParsedNpc npc = parseNpcLine(line);
+    return createNpc(npc.type, std::string(npc.name), npc.x, npc.y);
+}
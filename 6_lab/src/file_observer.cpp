@@ -0,0 +1,112 @@
+#include "../include/file_observer.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FileObserver::FileObserver(const std::string& filename)
+    : FileObserver(filename, Options{}) {}
+
+FileObserver::FileObserver(const std::string& filename, Options options)
+    : filename_(filename), options_(options), fd_(-1), fileSize_(0),
+      lastFlush_(std::chrono::steady_clock::now()) {
+    buffer_.reserve(options_.bufferSize);
+    open();
+}
+
+FileObserver::~FileObserver() {
+    try {
+        writeOut();
+    } catch (...) {
+        // деструктор не бросает исключений
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void FileObserver::notify(const std::string& event) {
+    buffer_.append(event);
+    buffer_.push_back('\n');
+
+    if (buffer_.size() >= options_.bufferSize) {
+        writeOut();
+    } else if (options_.flushInterval.count() > 0 &&
+               std::chrono::steady_clock::now() - lastFlush_ >= options_.flushInterval) {
+        writeOut();
+    }
+}
+
+void FileObserver::flush() {
+    if (options_.flushOnBatch) {
+        writeOut();
+    } else if (options_.flushInterval.count() > 0 &&
+               std::chrono::steady_clock::now() - lastFlush_ >= options_.flushInterval) {
+        writeOut();
+    }
+}
+
+void FileObserver::open() {
+    fd_ = ::open(filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    // как и раньше, недоступный файл не мешает работе: события просто не пишутся
+    if (fd_ < 0) return;
+    struct stat info;
+    fileSize_ = ::fstat(fd_, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+}
+
+// запись буфера одной пачкой системных вызовов
+void FileObserver::writeOut() {
+    lastFlush_ = std::chrono::steady_clock::now();
+    if (buffer_.empty()) return;
+    if (fd_ < 0) {
+        buffer_.clear();
+        return;
+    }
+
+    if (options_.maxFileSize > 0 && fileSize_ > 0 &&
+        fileSize_ + buffer_.size() > options_.maxFileSize) {
+        rotate();
+        if (fd_ < 0) {
+            buffer_.clear();
+            return;
+        }
+    }
+
+    const char* data = buffer_.data();
+    size_t left = buffer_.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd_, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            // ошибка записи не роняет игру, непоместившиеся строки теряются
+            break;
+        }
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+    fileSize_ += buffer_.size() - left;
+    buffer_.clear();
+
+    if (options_.syncOnFlush) {
+        ::fsync(fd_);
+    }
+}
+
+// filename -> filename.1 -> ... -> filename.N, самый старый удаляется
+void FileObserver::rotate() {
+    ::close(fd_);
+    fd_ = -1;
+
+    if (options_.maxFiles == 0) {
+        std::remove(filename_.c_str());
+    } else {
+        std::remove((filename_ + "." + std::to_string(options_.maxFiles)).c_str());
+        for (size_t i = options_.maxFiles; i > 1; --i) {
+            std::rename((filename_ + "." + std::to_string(i - 1)).c_str(),
+                        (filename_ + "." + std::to_string(i)).c_str());
+        }
+        std::rename(filename_.c_str(), (filename_ + ".1").c_str());
+    }
+    open();
+}
@@ -1,11 +1,12 @@
 #include "../include/npc.h"
+#include "../include/string_interner.h"
 #include <cmath>
 #include <ostream>
 #include <iostream>
 
 // реализация конструктора
-Npc::Npc(int x, int y, const std::string& type, const std::string& name)
-    : x_(x), y_(y), type_(type), name_(name) {}
+Npc::Npc(int x, int y, NpcType type, std::string_view name)
+    : x_(x), y_(y), type_(type), nameId_(StringInterner::global().intern(name)) {}
 
 // реализация геттеров для координат и свойств
 int Npc::getX() const { 
@@ -16,19 +17,28 @@ int Npc::getY() const {
     return y_; 
 }
 
-std::string Npc::getType() const { 
-    return type_; 
+std::string_view Npc::getType() const { 
+    return npcTypeName(type_); 
 }
 
-std::string Npc::getName() const { 
-    return name_; 
+NpcType Npc::getTypeId() const {
+    return type_;
 }
 
-// вычисление расстояния по теореме пифагора
+std::string_view Npc::getName() const { 
+    return StringInterner::global().view(nameId_); 
+}
+
+uint32_t Npc::getNameId() const {
+    return nameId_;
+}
+
+// вычисление расстояния по теореме пифагора; квадраты в int64_t - на карте
+// MAX_WIDTH x MAX_HEIGHT сумма не помещается в int
 double Npc::distanceTo(const Npc& other) const {
-    int dx = x_ - other.x_;
-    int dy = y_ - other.y_;
-    return std::sqrt(dx * dx + dy * dy);
+    const int64_t dx = static_cast<int64_t>(x_) - other.x_;
+    const int64_t dy = static_cast<int64_t>(y_) - other.y_;
+    return std::sqrt(static_cast<double>(dx * dx + dy * dy));
 }
 
 void Npc::printInfo() const {
@@ -37,7 +47,7 @@ void Npc::printInfo() const {
 
 // оператор вывода в поток
 std::ostream& operator<<(std::ostream& os, const Npc& npc) {
-    os << "NPC [" << npc.type_ << "] " << npc.name_
+    os << "NPC [" << npcTypeName(npc.type_) << "] " << npc.getName()
        << " @ (" << npc.x_ << ", " << npc.y_ << ")";
     return os;
 }
\ No newline at end of file
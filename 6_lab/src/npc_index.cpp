@@ -0,0 +1,155 @@
+#include "../include/npc_index.h"
+#include "../include/string_interner.h"
+#include <queue>
+
+// при удалении большей доли строк дешевле построить индекс заново при запросе
+static const size_t REBUILD_DIVISOR = 16;
+
+bool NpcIndex::built() const {
+    return built_;
+}
+
+void NpcIndex::build(const NpcStore& store, int width, int height) {
+    side_ = std::max(1, (std::max(width, height) + CELLS_PER_SIDE) / CELLS_PER_SIDE);
+    cols_ = width / side_ + 1;
+    rows_ = height / side_ + 1;
+    cells_.resize(static_cast<size_t>(cols_) * rows_);
+    for (auto& cell : cells_) cell.clear();
+    size_ = 0;
+    typeCounts_.fill(0);
+    built_ = true;
+
+    const auto& xs = store.x();
+    const auto& ys = store.y();
+    const auto& types = store.typeId();
+    const auto& names = store.nameId();
+    for (size_t row = 0; row < store.size(); ++row) {
+        insert(names[row], types[row], xs[row], ys[row]);
+    }
+}
+
+void NpcIndex::invalidate() {
+    built_ = false;
+}
+
+void NpcIndex::insert(uint32_t nameId, NpcType type, int x, int y) {
+    if (!built_) return;
+    cellOf(x, y).push_back({nameId, x, y, type});
+    ++size_;
+    ++typeCounts_[npcTypeIndex(type)];
+}
+
+void NpcIndex::erase(uint32_t nameId, int x, int y) {
+    if (!built_) return;
+    auto& cell = cellOf(x, y);
+    for (size_t i = 0; i < cell.size(); ++i) {
+        if (cell[i].nameId != nameId) continue;
+        --size_;
+        --typeCounts_[npcTypeIndex(cell[i].type)];
+        cell[i] = cell.back();
+        cell.pop_back();
+        return;
+    }
+}
+
+void NpcIndex::move(uint32_t nameId, int fromX, int fromY, int x, int y) {
+    if (!built_) return;
+    auto& from = cellOf(fromX, fromY);
+    auto& to = cellOf(x, y);
+    for (size_t i = 0; i < from.size(); ++i) {
+        if (from[i].nameId != nameId) continue;
+        Entry entry = from[i];
+        entry.x = x;
+        entry.y = y;
+        if (&from == &to) {
+            from[i] = entry;
+        } else {
+            from[i] = from.back();
+            from.pop_back();
+            to.push_back(entry);
+        }
+        return;
+    }
+}
+
+void NpcIndex::eraseMarked(const std::vector<uint64_t>& marked, const NpcStore& store) {
+    if (!built_) return;
+    size_t count = 0;
+    for (uint64_t word : marked) count += static_cast<size_t>(__builtin_popcountll(word));
+    if (count * REBUILD_DIVISOR > size_) {
+        invalidate();
+        return;
+    }
+    for (size_t w = 0; w < marked.size(); ++w) {
+        for (uint64_t word = marked[w]; word != 0; word &= word - 1) {
+            const size_t row = w * 64 + static_cast<size_t>(__builtin_ctzll(word));
+            erase(store.nameId()[row], store.x()[row], store.y()[row]);
+        }
+    }
+}
+
+// поиск кольцами ячеек вокруг точки: ячейки кольца r не ближе (r - 1) * side_,
+// поиск останавливается, когда это расстояние больше k-го найденного
+std::vector<NpcIndex::Entry> NpcIndex::nearest(int x, int y, size_t k, const NpcType* filter) const {
+    std::vector<Entry> result;
+    if (!built_) return result;
+    k = std::min(k, filter ? typeCounts_[npcTypeIndex(*filter)] : size_);
+    if (k == 0) return result;
+
+    const StringInterner& interner = StringInterner::global();
+    auto squaredDistance = [x, y](const Entry& entry) {
+        const int64_t dx = static_cast<int64_t>(entry.x) - x;
+        const int64_t dy = static_cast<int64_t>(entry.y) - y;
+        return dx * dx + dy * dy;
+    };
+    // порядок ответа: ближе, при равном расстоянии - меньшее имя
+    auto closer = [&](const std::pair<int64_t, Entry>& a, const std::pair<int64_t, Entry>& b) {
+        if (a.first != b.first) return a.first < b.first;
+        return interner.view(a.second.nameId) < interner.view(b.second.nameId);
+    };
+    // на вершине кучи - худший из k лучших
+    std::priority_queue<std::pair<int64_t, Entry>, std::vector<std::pair<int64_t, Entry>>, decltype(closer)>
+        best(closer);
+
+    const int cx = cellCoord(x, cols_);
+    const int cy = cellCoord(y, rows_);
+    const int maxRing = std::max({cx, cols_ - 1 - cx, cy, rows_ - 1 - cy});
+    for (int ring = 0; ring <= maxRing; ++ring) {
+        if (best.size() == k && ring > 0) {
+            const int64_t gap = static_cast<int64_t>(ring - 1) * side_;
+            if (gap * gap > best.top().first) break;
+        }
+        auto visit = [&](int nx, int ny) {
+            if (nx < 0 || ny < 0 || nx >= cols_ || ny >= rows_) return;
+            for (const Entry& entry : cells_[static_cast<size_t>(ny) * cols_ + nx]) {
+                if (filter && entry.type != *filter) continue;
+                std::pair<int64_t, Entry> candidate{squaredDistance(entry), entry};
+                if (best.size() < k) {
+                    best.push(candidate);
+                } else if (closer(candidate, best.top())) {
+                    best.pop();
+                    best.push(candidate);
+                }
+            }
+        };
+        if (ring == 0) {
+            visit(cx, cy);
+            continue;
+        }
+        for (int nx = cx - ring; nx <= cx + ring; ++nx) {
+            visit(nx, cy - ring);
+            visit(nx, cy + ring);
+        }
+        for (int ny = cy - ring + 1; ny <= cy + ring - 1; ++ny) {
+            visit(cx - ring, ny);
+            visit(cx + ring, ny);
+        }
+    }
+
+    result.resize(best.size());
+    for (size_t i = result.size(); i > 0; --i) {
+        result[i - 1] = best.top().second;
+        best.pop();
+    }
+    return result;
+}
@@ -0,0 +1,68 @@
+#include "../include/npc_parser.h"
+#include <charconv>
+#include <stdexcept>
+#include <string>
+
+// пробельные символы те же, что пропускает operator>> в локали "C"
+static bool isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static void skipSpaces(const char*& pos, const char* end) {
+    while (pos != end && isSpace(*pos)) ++pos;
+}
+
+static bool readToken(const char*& pos, const char* end, std::string_view& token) {
+    skipSpaces(pos, end);
+    const char* begin = pos;
+    while (pos != end && !isSpace(*pos)) ++pos;
+    token = std::string_view(begin, static_cast<size_t>(pos - begin));
+    return !token.empty();
+}
+
+// целое как у operator>>: знак, цифры, остаток строки читается дальше
+static bool readInt(const char*& pos, const char* end, int& value) {
+    skipSpaces(pos, end);
+    if (pos != end && *pos == '+') {
+        ++pos;
+        if (pos == end || *pos < '0' || *pos > '9') return false;
+    }
+    auto result = std::from_chars(pos, end, value);
+    if (result.ec != std::errc()) return false;
+    pos = result.ptr;
+    return true;
+}
+
+ParsedNpc parseNpcLine(std::string_view line) {
+    const char* pos = line.data();
+    const char* end = pos + line.size();
+
+    std::string_view type;
+    ParsedNpc npc{};
+    if (!readToken(pos, end, type) || !readToken(pos, end, npc.name) ||
+        !readInt(pos, end, npc.x) || !readInt(pos, end, npc.y)) {
+        throw std::runtime_error("Failed to read line: " + std::string(line));
+    }
+
+    if (!parseNpcType(type, npc.type)) {
+        throw std::invalid_argument("Unknown NPC type: " + std::string(type));
+    }
+    return npc;
+}
+
+std::vector<std::string_view> splitNpcText(std::string_view text, size_t chunkBytes) {
+    std::vector<std::string_view> chunks;
+    if (chunkBytes == 0) chunkBytes = 1;
+    while (!text.empty()) {
+        if (text.size() <= chunkBytes) {
+            chunks.push_back(text);
+            break;
+        }
+        // кусок продлевается до конца строки, на которую попала граница
+        const size_t newline = text.find('\n', chunkBytes - 1);
+        const size_t length = newline == std::string_view::npos ? text.size() : newline + 1;
+        chunks.push_back(text.substr(0, length));
+        text.remove_prefix(length);
+    }
+    return chunks;
+}
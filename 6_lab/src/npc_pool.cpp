@@ -0,0 +1,107 @@
+#include "../include/npc_pool.h"
+#include "../include/npc_registry.h"
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// размер и выравнивание ячейки и конструктор для каждого типа из реестра
+struct SlabLayout {
+    size_t size;
+    size_t align;
+    Npc* (*construct)(void* cell, int x, int y, const std::string& name);
+};
+
+template <typename... Npcs>
+constexpr std::array<SlabLayout, NPC_TYPE_COUNT> buildLayouts(NpcTypeList<Npcs...>) {
+    std::array<SlabLayout, NPC_TYPE_COUNT> layouts{};
+    ((layouts[npcTypeIndex(Npcs::typeId)] = SlabLayout{
+         // в свободной ячейке лежит указатель на следующую
+         sizeof(Npcs) < sizeof(void*) ? sizeof(void*) : sizeof(Npcs),
+         alignof(Npcs) < alignof(void*) ? alignof(void*) : alignof(Npcs),
+         [](void* cell, int x, int y, const std::string& name) -> Npc* {
+             return new (cell) Npcs(x, y, name);
+         }}), ...);
+    return layouts;
+}
+
+const std::array<SlabLayout, NPC_TYPE_COUNT> LAYOUTS = buildLayouts(AllNpcTypes{});
+
+}
+
+// при живых объектах блоки не освобождаются: лучше утечка, чем запись
+// в освобождённую память; сами Ptr всё равно не должны пережить пул
+NpcPool::~NpcPool() {
+    if (live() == 0) clear();
+}
+
+NpcPool::Ptr NpcPool::create(NpcType type, const std::string& name, int x, int y) {
+    void* cell = allocate(type);
+    try {
+        return Ptr(LAYOUTS[npcTypeIndex(type)].construct(cell, x, y, name), Deleter{this});
+    } catch (...) {
+        deallocate(type, cell);
+        throw;
+    }
+}
+
+void NpcPool::Deleter::operator()(Npc* npc) const {
+    const NpcType type = npc->getTypeId();
+    npc->~Npc();
+    pool->deallocate(type, npc);
+}
+
+size_t NpcPool::live() const {
+    size_t result = 0;
+    for (const auto& slab : slabs_) result += slab.live;
+    return result;
+}
+
+size_t NpcPool::capacity() const {
+    size_t result = 0;
+    for (const auto& slab : slabs_) result += slab.cells;
+    return result;
+}
+
+void NpcPool::clear() {
+    if (live() != 0) {
+        throw std::logic_error("NpcPool::clear with " + std::to_string(live()) + " live objects.");
+    }
+    for (size_t i = 0; i < NPC_TYPE_COUNT; ++i) {
+        Slab& slab = slabs_[i];
+        for (void* block : slab.blocks) {
+            ::operator delete(block, std::align_val_t(LAYOUTS[i].align));
+        }
+        slab = Slab{};
+    }
+}
+
+// ячейка из списка свободных, а если он пуст - новый блок целиком в список
+void* NpcPool::allocate(NpcType type) {
+    Slab& slab = slabs_[npcTypeIndex(type)];
+    if (!slab.freeList) {
+        const SlabLayout& layout = LAYOUTS[npcTypeIndex(type)];
+        const size_t stride = (layout.size + layout.align - 1) / layout.align * layout.align;
+        char* block = static_cast<char*>(
+            ::operator new(stride * CELLS_PER_BLOCK, std::align_val_t(layout.align)));
+        slab.blocks.push_back(block);
+        for (size_t i = CELLS_PER_BLOCK; i-- > 0;) {
+            void* cell = block + i * stride;
+            *static_cast<void**>(cell) = slab.freeList;
+            slab.freeList = cell;
+        }
+        slab.cells += CELLS_PER_BLOCK;
+    }
+    void* cell = slab.freeList;
+    slab.freeList = *static_cast<void**>(cell);
+    ++slab.live;
+    return cell;
+}
+
+void NpcPool::deallocate(NpcType type, void* cell) {
+    Slab& slab = slabs_[npcTypeIndex(type)];
+    *static_cast<void**>(cell) = slab.freeList;
+    slab.freeList = cell;
+    --slab.live;
+}
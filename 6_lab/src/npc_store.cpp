@@ -0,0 +1,176 @@
+#include "../include/npc_store.h"
+#include "../include/string_interner.h"
+#include <algorithm>
+#include <bit>
+
+static const uint64_t EMPTY_SLOT = UINT64_MAX;
+
+// перемешивание id, чтобы последовательные имена не слипались в таблице
+static size_t mix(uint32_t value) {
+    uint64_t h = value * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(h >> 32);
+}
+
+uint32_t NpcStore::insert(uint32_t nameId, NpcType typeId, int x, int y) {
+    const uint32_t row = static_cast<uint32_t>(x_.size());
+    x_.push_back(x);
+    y_.push_back(y);
+    typeId_.push_back(typeId);
+    nameId_.push_back(nameId);
+    placeIndex(nameId, row);
+    return row;
+}
+
+uint32_t NpcStore::find(uint32_t nameId) const {
+    if (slots_.empty()) return npos;
+    uint64_t slot = slots_[slotOf(nameId)];
+    return slot == EMPTY_SLOT ? npos : static_cast<uint32_t>(slot);
+}
+
+void NpcStore::erase(uint32_t row) {
+    const uint32_t last = static_cast<uint32_t>(x_.size() - 1);
+    eraseIndex(nameId_[row]);
+    if (row != last) {
+        x_[row] = x_[last];
+        y_[row] = y_[last];
+        typeId_[row] = typeId_[last];
+        nameId_[row] = nameId_[last];
+        placeIndex(nameId_[row], row);
+    }
+    x_.pop_back();
+    y_.pop_back();
+    typeId_.pop_back();
+    nameId_.pop_back();
+}
+
+// при малом числе удалённых дешевле переносить последние строки на их место,
+// при большом - сжать столбцы одним проходом и заново заполнить таблицу
+static const size_t COMPACT_DIVISOR = 16;
+
+size_t NpcStore::eraseMarked(const std::vector<uint64_t>& marked) {
+    const size_t words = std::min(marked.size(), (x_.size() + 63) / 64);
+    size_t count = 0;
+    for (size_t w = 0; w < words; ++w) {
+        count += std::popcount(marked[w]);
+    }
+    if (count == 0) return 0;
+
+    if (count * COMPACT_DIVISOR < x_.size()) {
+        // по убыванию номеров: перенос последней строки не затрагивает ещё не удалённые
+        for (size_t w = words; w-- > 0;) {
+            uint64_t bits = marked[w];
+            while (bits) {
+                const int bit = 63 - std::countl_zero(bits);
+                bits &= ~(uint64_t{1} << bit);
+                erase(static_cast<uint32_t>(w * 64 + bit));
+            }
+        }
+        return count;
+    }
+
+    // сжатие с сохранением порядка выживших
+    size_t out = 0;
+    for (size_t row = 0; row < x_.size(); ++row) {
+        if (row / 64 < words && (marked[row / 64] >> (row % 64)) & 1) continue;
+        x_[out] = x_[row];
+        y_[out] = y_[row];
+        typeId_[out] = typeId_[row];
+        nameId_[out] = nameId_[row];
+        ++out;
+    }
+    x_.resize(out);
+    y_.resize(out);
+    typeId_.resize(out);
+    nameId_.resize(out);
+    rebuildIndex();
+    return count;
+}
+
+void NpcStore::move(uint32_t row, int x, int y) {
+    x_[row] = x;
+    y_[row] = y;
+}
+
+void NpcStore::reserve(size_t count) {
+    x_.reserve(count);
+    y_.reserve(count);
+    typeId_.reserve(count);
+    nameId_.reserve(count);
+    while (slots_.size() < count * 2) {
+        growIndex();
+    }
+}
+
+void NpcStore::clear() {
+    x_.clear();
+    y_.clear();
+    typeId_.clear();
+    nameId_.clear();
+    slots_.clear();
+}
+
+size_t NpcStore::size() const {
+    return x_.size();
+}
+
+const std::vector<int>& NpcStore::x() const { return x_; }
+const std::vector<int>& NpcStore::y() const { return y_; }
+const std::vector<NpcType>& NpcStore::typeId() const { return typeId_; }
+const std::vector<uint32_t>& NpcStore::nameId() const { return nameId_; }
+
+std::string_view NpcStore::name(uint32_t row) const {
+    return StringInterner::global().view(nameId_[row]);
+}
+
+// линейное пробирование: слот с нужным id или первый пустой
+size_t NpcStore::slotOf(uint32_t nameId) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = mix(nameId) & mask;
+    while (slots_[slot] != EMPTY_SLOT && (slots_[slot] >> 32) != nameId) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void NpcStore::placeIndex(uint32_t nameId, uint32_t row) {
+    if ((x_.size() + 1) * 2 > slots_.size()) {
+        growIndex();
+    }
+    slots_[slotOf(nameId)] = (static_cast<uint64_t>(nameId) << 32) | row;
+}
+
+// удаление со сдвигом назад, без надгробий
+void NpcStore::eraseIndex(uint32_t nameId) {
+    const size_t mask = slots_.size() - 1;
+    size_t hole = slotOf(nameId);
+    if (slots_[hole] == EMPTY_SLOT) return;
+
+    size_t next = (hole + 1) & mask;
+    while (slots_[next] != EMPTY_SLOT) {
+        size_t home = mix(static_cast<uint32_t>(slots_[next] >> 32)) & mask;
+        // элемент можно сдвинуть в дыру, если дыра лежит между его домом и текущим слотом
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            slots_[hole] = slots_[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    slots_[hole] = EMPTY_SLOT;
+}
+
+// таблица заполняется заново текущими строками, размер не меняется
+void NpcStore::rebuildIndex() {
+    std::fill(slots_.begin(), slots_.end(), EMPTY_SLOT);
+    for (uint32_t row = 0; row < nameId_.size(); ++row) {
+        slots_[slotOf(nameId_[row])] = (static_cast<uint64_t>(nameId_[row]) << 32) | row;
+    }
+}
+
+void NpcStore::growIndex() {
+    std::vector<uint64_t> old(slots_.empty() ? 16 : slots_.size() * 2, EMPTY_SLOT);
+    old.swap(slots_);
+    for (uint64_t entry : old) {
+        if (entry == EMPTY_SLOT) continue;
+        slots_[slotOf(static_cast<uint32_t>(entry >> 32))] = entry;
+    }
+}
@@ -0,0 +1,16 @@
+#include "../include/npc_type.h"
+#include "../include/npc_registry.h"
+
+std::string_view npcTypeName(NpcType type) {
+    return NPC_TYPE_NAMES[npcTypeIndex(type)];
+}
+
+// один слот по хешу и одно сравнение строк
+bool parseNpcType(std::string_view name, NpcType& type) {
+    const uint8_t index = NPC_TYPE_HASH.slots[typeNameSlot(name, NPC_TYPE_HASH.seed)];
+    if (index == TYPE_HASH_EMPTY || NPC_TYPE_NAMES[index] != name) {
+        return false;
+    }
+    type = static_cast<NpcType>(index);
+    return true;
+}
@@ -2,10 +2,8 @@
 #include "../include/visitor.h"
 #include <iostream>
 
-const std::string Pegasus::type_ = "Pegasus";
-
 Pegasus::Pegasus(int x, int y, const std::string& name)
-    : Npc(x, y, type_, name) 
+    : Npc(x, y, typeId, name) 
 {
     // конструктор пегаса
 }
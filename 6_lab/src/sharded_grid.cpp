@@ -0,0 +1,107 @@
+#include "../include/sharded_grid.h"
+#include <algorithm>
+#include <cmath>
+
+// ширина ячейки, при которой все пары в пределах боя лежат в соседних ячейках
+static int cellSideFor(double range) {
+    return static_cast<int>(std::ceil(std::max(range, 1.0)));
+}
+
+bool ShardedGrid::needed(int width, int height, double range) {
+    const double side = std::max(range, 1.0);
+    const double cells = (std::floor(width / side) + 1) * (std::floor(height / side) + 1);
+    return cells > static_cast<double>(SpatialGrid::MAX_CELLS);
+}
+
+void ShardedGrid::build(const int* xs, const int* ys, size_t count, double range) {
+    xs_ = xs;
+    ys_ = ys;
+    range_ = range;
+    halo_ = cellSideFor(range);
+    side_ = halo_ * TILE_CELLS;
+
+    int maxX = 0;
+    for (size_t i = 0; i < count; ++i) maxX = std::max(maxX, xs[i]);
+    tilesX_ = maxX / side_ + 1;
+
+    order_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t key = static_cast<uint64_t>(ys[i] / side_) * tilesX_ + xs[i] / side_;
+        order_[i] = (key << 32) | i;
+    }
+    std::sort(order_.begin(), order_.end());
+
+    keys_.clear();
+    start_.clear();
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t key = order_[i] >> 32;
+        if (keys_.empty() || keys_.back() != key) {
+            keys_.push_back(key);
+            start_.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    start_.push_back(static_cast<uint32_t>(count));
+}
+
+void ShardedGrid::clear() {
+    order_.clear();
+    keys_.clear();
+    start_.clear();
+    xs_ = ys_ = nullptr;
+}
+
+size_t ShardedGrid::shardCount() const {
+    return keys_.size();
+}
+
+size_t ShardedGrid::findShard(uint64_t key) const {
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    return it != keys_.end() && *it == key ? static_cast<size_t>(it - keys_.begin()) : keys_.size();
+}
+
+ShardedGrid::Offset ShardedGrid::buildShard(size_t shard, SpatialGrid& grid, std::vector<uint32_t>& own) const {
+    const uint64_t key = keys_[shard];
+    const int64_t tx = static_cast<int64_t>(key % tilesX_);
+    const int64_t ty = static_cast<int64_t>(key / tilesX_);
+    const int64_t left = tx * side_;
+    const int64_t bottom = ty * side_;
+
+    // ореол: полоса шириной halo_ вокруг плитки, локальные координаты неотрицательны
+    const Offset offset{static_cast<int>(left - halo_), static_cast<int>(bottom - halo_)};
+    const int extent = side_ + 2 * halo_;
+
+    own.clear();
+    for (uint32_t k = start_[shard]; k < start_[shard + 1]; ++k) {
+        own.push_back(static_cast<uint32_t>(order_[k]));
+    }
+
+    // сетка плитки мельче, если в ней мало NPC: перебор внутри крупной ячейки дешевле,
+    // чем обход пустых ячеек
+    size_t members = own.size();
+    auto forEachHalo = [&](auto&& fn) {
+        for (int64_t ny = ty - 1; ny <= ty + 1; ++ny) {
+            for (int64_t nx = tx - 1; nx <= tx + 1; ++nx) {
+                if ((nx == tx && ny == ty) || nx < 0 || ny < 0 || nx >= tilesX_) continue;
+                const size_t neighbour = findShard(static_cast<uint64_t>(ny * tilesX_ + nx));
+                if (neighbour == keys_.size()) continue;
+                for (uint32_t k = start_[neighbour]; k < start_[neighbour + 1]; ++k) {
+                    const uint32_t row = static_cast<uint32_t>(order_[k]);
+                    const int64_t lx = static_cast<int64_t>(xs_[row]) - offset.x;
+                    const int64_t ly = static_cast<int64_t>(ys_[row]) - offset.y;
+                    if (lx >= 0 && lx <= extent && ly >= 0 && ly <= extent) fn(row);
+                }
+            }
+        }
+    };
+    forEachHalo([&](uint32_t) { ++members; });
+
+    size_t cells = 64;
+    while (cells < members * 2 && cells < SpatialGrid::MAX_CELLS) cells *= 2;
+    grid.reset(extent, extent, range_, cells);
+    for (uint32_t row : own) {
+        grid.insert(row, xs_[row] - offset.x, ys_[row] - offset.y);
+    }
+    forEachHalo([&](uint32_t row) { grid.insert(row, xs_[row] - offset.x, ys_[row] - offset.y); });
+    grid.build();
+    return offset;
+}
@@ -0,0 +1,313 @@
+#include "../include/snapshot.h"
+#include "../include/npc_parser.h"
+#include "../include/string_interner.h"
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+static size_t alignUp(size_t value) {
+    return (value + 3) & ~size_t{3};
+}
+
+// FNV-1a по 8-байтовым словам: на больших снимках заметно быстрее побайтового
+static uint64_t checksumOf(const char* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+SnapshotFormat detectSnapshotFormat(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file for reading: " + filename);
+    }
+    char magic[sizeof(SNAPSHOT_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    if (file.gcount() == sizeof(magic) && std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0) {
+        return SnapshotFormat::Binary;
+    }
+    return SnapshotFormat::Text;
+}
+
+void writeBinarySnapshot(const std::string& filename, const NpcStore& store,
+                         const std::vector<uint32_t>& rows) {
+    const size_t count = rows.size();
+    const auto& xs = store.x();
+    const auto& ys = store.y();
+    const auto& types = store.typeId();
+
+    std::vector<uint32_t> offsets(count + 1, 0);
+    uint64_t stringBytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        stringBytes += store.name(rows[i]).size();
+        if (stringBytes > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("Snapshot string table is too large: " + filename);
+        }
+        offsets[i + 1] = static_cast<uint32_t>(stringBytes);
+    }
+
+    // тело собирается целиком в памяти, чтобы посчитать сумму и записать его одним вызовом
+    const size_t offsetsSize = (count + 1) * sizeof(uint32_t);
+    const size_t namesEnd = offsetsSize + alignUp(stringBytes);
+    std::vector<char> body(namesEnd + count * (2 * sizeof(int32_t) + 1), 0);
+
+    std::memcpy(body.data(), offsets.data(), offsetsSize);
+    char* names = body.data() + offsetsSize;
+    int32_t* outX = reinterpret_cast<int32_t*>(body.data() + namesEnd);
+    int32_t* outY = outX + count;
+    uint8_t* outType = reinterpret_cast<uint8_t*>(outY + count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t row = rows[i];
+        std::string_view name = store.name(row);
+        std::memcpy(names + offsets[i], name.data(), name.size());
+        outX[i] = xs[row];
+        outY[i] = ys[row];
+        outType[i] = static_cast<uint8_t>(types[row]);
+    }
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.count = count;
+    header.stringBytes = stringBytes;
+    header.checksum = checksumOf(body.data(), body.size());
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + filename);
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(body.data(), static_cast<std::streamsize>(body.size()));
+    if (!file) {
+        throw std::runtime_error("Cannot write to file: " + filename);
+    }
+}
+
+namespace {
+
+// буферизованная запись тела снимка с подсчётом той же суммы, что и у checksumOf:
+// в файл уходят только целые 8-байтовые слова, остаток ждёт следующей порции
+class ChecksumWriter {
+public:
+    ChecksumWriter(std::ofstream& file, const std::string& filename) : file_(file), filename_(filename) {
+        buffer_.reserve(BUFFER_SIZE + 8);
+    }
+
+    void write(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+        if (buffer_.size() >= BUFFER_SIZE) drain();
+    }
+
+    uint64_t finish() {
+        drain();
+        for (char c : buffer_) {
+            hash_ = (hash_ ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+        }
+        put(buffer_.data(), buffer_.size());
+        buffer_.clear();
+        return hash_;
+    }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    std::ofstream& file_;
+    const std::string& filename_;
+    std::vector<char> buffer_;
+    uint64_t hash_ = 0xcbf29ce484222325ull;
+
+    void drain() {
+        const size_t whole = buffer_.size() & ~size_t{7};
+        for (size_t i = 0; i < whole; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, buffer_.data() + i, sizeof(word));
+            hash_ = (hash_ ^ word) * 0x100000001b3ull;
+        }
+        put(buffer_.data(), whole);
+        buffer_.erase(buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(whole));
+    }
+
+    void put(const char* data, size_t size) {
+        file_.write(data, static_cast<std::streamsize>(size));
+        if (!file_) {
+            throw std::runtime_error("Cannot write to file: " + filename_);
+        }
+    }
+};
+
+}
+
+void writeBinarySnapshot(const std::string& filename,
+                         const std::function<void(const SnapshotSink& sink)>& replay) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + filename);
+    }
+
+    // заголовок дописывается в конце, когда известны размеры и сумма
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    ChecksumWriter body(file, filename);
+    uint64_t count = 0;
+    uint64_t stringBytes = 0;
+    const uint32_t zero = 0;
+    body.write(&zero, sizeof(zero));
+    replay([&](NpcType, std::string_view name, int, int) {
+        stringBytes += name.size();
+        if (stringBytes > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("Snapshot string table is too large: " + filename);
+        }
+        const uint32_t offset = static_cast<uint32_t>(stringBytes);
+        body.write(&offset, sizeof(offset));
+        ++count;
+    });
+
+    // остальные столбцы; источник обязан выдавать те же NPC, что и в первый проход
+    auto pass = [&](const SnapshotSink& sink) {
+        uint64_t seen = 0;
+        replay([&](NpcType type, std::string_view name, int x, int y) {
+            ++seen;
+            sink(type, name, x, y);
+        });
+        if (seen != count) {
+            throw std::logic_error("Snapshot source changed between passes.");
+        }
+    };
+    pass([&](NpcType, std::string_view name, int, int) { body.write(name.data(), name.size()); });
+    const char padding[4] = {};
+    body.write(padding, alignUp(stringBytes) - stringBytes);
+    pass([&](NpcType, std::string_view, int x, int) {
+        const int32_t value = x;
+        body.write(&value, sizeof(value));
+    });
+    pass([&](NpcType, std::string_view, int, int y) {
+        const int32_t value = y;
+        body.write(&value, sizeof(value));
+    });
+    pass([&](NpcType type, std::string_view, int, int) {
+        const uint8_t value = static_cast<uint8_t>(type);
+        body.write(&value, sizeof(value));
+    });
+
+    header.count = count;
+    header.stringBytes = stringBytes;
+    header.checksum = body.finish();
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file) {
+        throw std::runtime_error("Cannot write to file: " + filename);
+    }
+}
+
+MappedSnapshot::MappedSnapshot(const std::string& filename)
+    : file_(filename), count_(0), offsets_(nullptr), names_(nullptr),
+      xs_(nullptr), ys_(nullptr), types_(nullptr) {
+    auto fail = [&]() {
+        throw std::runtime_error("Invalid snapshot file: " + filename);
+    };
+    if (file_.size() < sizeof(SnapshotHeader)) fail();
+
+    const char* base = file_.data();
+    SnapshotHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SNAPSHOT_VERSION || header.headerSize != sizeof(SnapshotHeader)) {
+        fail();
+    }
+
+    // размеры проверяются до любых обращений к столбцам
+    const size_t bodySize = file_.size() - sizeof(SnapshotHeader);
+    if (header.count > bodySize || header.stringBytes > bodySize) fail();
+    const size_t count = static_cast<size_t>(header.count);
+    const size_t offsetsSize = (count + 1) * sizeof(uint32_t);
+    const size_t namesEnd = offsetsSize + alignUp(static_cast<size_t>(header.stringBytes));
+    if (namesEnd + count * (2 * sizeof(int32_t) + 1) != bodySize) fail();
+
+    const char* body = base + sizeof(SnapshotHeader);
+    if (checksumOf(body, bodySize) != header.checksum) fail();
+
+    count_ = count;
+    offsets_ = reinterpret_cast<const uint32_t*>(body);
+    names_ = body + offsetsSize;
+    xs_ = reinterpret_cast<const int32_t*>(body + namesEnd);
+    ys_ = xs_ + count;
+    types_ = reinterpret_cast<const uint8_t*>(ys_ + count);
+
+    // смещения не убывают и не выходят за таблицу строк, типы известны
+    if (offsets_[0] != 0 || offsets_[count] != header.stringBytes) fail();
+    for (size_t i = 0; i < count; ++i) {
+        if (offsets_[i + 1] < offsets_[i] || types_[i] >= NPC_TYPE_COUNT) fail();
+    }
+}
+
+void convertSnapshot(const std::string& input, const std::string& output, SnapshotFormat format) {
+    const SnapshotFormat from = detectSnapshotFormat(input);
+    if (format == SnapshotFormat::Auto) {
+        // без явного формата - в противоположный
+        format = from == SnapshotFormat::Binary ? SnapshotFormat::Text : SnapshotFormat::Binary;
+    }
+
+    if (from == SnapshotFormat::Binary) {
+        MappedSnapshot snapshot(input);
+        if (format == SnapshotFormat::Text) {
+            std::ofstream file(output);
+            if (!file.is_open()) {
+                throw std::runtime_error("Cannot open file for writing: " + output);
+            }
+            for (size_t i = 0; i < snapshot.size(); ++i) {
+                file << npcTypeName(snapshot.type(i)) << " " << snapshot.name(i) << " "
+                     << snapshot.x(i) << " " << snapshot.y(i) << "\n";
+            }
+            return;
+        }
+        NpcStore store;
+        std::vector<uint32_t> rows(snapshot.size());
+        store.reserve(snapshot.size());
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            rows[i] = store.insert(StringInterner::global().intern(snapshot.name(i)),
+                                   snapshot.type(i), snapshot.x(i), snapshot.y(i));
+        }
+        writeBinarySnapshot(output, store, rows);
+        return;
+    }
+
+    // текстовый вход: порядок строк файла сохраняется
+    MappedFile file(input);
+    NpcStore store;
+    std::vector<uint32_t> rows;
+    forEachNpcLine(file.view(), [&](const ParsedNpc& npc) {
+        const uint32_t nameId = StringInterner::global().intern(npc.name);
+        if (store.find(nameId) != NpcStore::npos) {
+            throw std::invalid_argument("NPC with this name already exists.");
+        }
+        rows.push_back(store.insert(nameId, npc.type, npc.x, npc.y));
+    });
+
+    if (format == SnapshotFormat::Binary) {
+        writeBinarySnapshot(output, store, rows);
+        return;
+    }
+    std::ofstream out(output);
+    if (!out.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + output);
+    }
+    for (uint32_t row : rows) {
+        out << npcTypeName(store.typeId()[row]) << " " << store.name(row) << " "
+            << store.x()[row] << " " << store.y()[row] << "\n";
+    }
+}
@@ -0,0 +1,113 @@
+#include "../include/spatial_grid.h"
+#include <algorithm>
+#include <cmath>
+
+void SpatialGrid::reset(int width, int height, double range, size_t maxCells) {
+    // ячейка не меньше дальности: все пары в пределах боя лежат в соседних ячейках
+    double size = std::max(range, 1.0);
+    size = std::min(size, static_cast<double>(std::max(width, height)) + 1.0);
+
+    auto dimension = [&](int extent) {
+        return static_cast<int>(std::floor(extent / size)) + 1;
+    };
+    while (static_cast<size_t>(dimension(width)) * dimension(height) > maxCells) {
+        size *= 2.0;
+    }
+
+    cellSize_ = size;
+    cols_ = dimension(width);
+    rows_ = dimension(height);
+    clear();
+}
+
+void SpatialGrid::insert(uint32_t id, int x, int y) {
+    pendingXs_.push_back(x);
+    pendingYs_.push_back(y);
+    pendingIds_.push_back(id);
+}
+
+void SpatialGrid::build() {
+    sortByCell(pendingXs_.data(), pendingYs_.data(), pendingIds_.data(), pendingIds_.size());
+}
+
+void SpatialGrid::build(const int* xs, const int* ys, size_t count) {
+    sortByCell(xs, ys, nullptr, count);
+}
+
+void SpatialGrid::clear() {
+    start_.assign(static_cast<size_t>(cols_) * rows_ + 1, 0);
+    xs_.clear();
+    ys_.clear();
+    ids_.clear();
+    pendingXs_.clear();
+    pendingYs_.clear();
+    pendingIds_.clear();
+    maxBlock_ = 0;
+}
+
+// сортировка подсчётом: размеры ячеек, префиксные суммы, раскладка;
+// внутри ячейки записи идут в исходном порядке
+void SpatialGrid::sortByCell(const int* xs, const int* ys, const uint32_t* ids, size_t count) {
+    const size_t cells = cellCount();
+    start_.assign(cells + 1, 0);
+    cellOf_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t cell = static_cast<uint32_t>(cellIndex(xs[i], ys[i]));
+        cellOf_[i] = cell;
+        ++start_[cell + 1];
+    }
+    for (size_t c = 0; c < cells; ++c) {
+        start_[c + 1] += start_[c];
+    }
+
+    xs_.resize(count);
+    ys_.resize(count);
+    ids_.resize(count);
+    // start_[c] едет к концу ячейки, после раскладки массив сдвигается обратно
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t slot = start_[cellOf_[i]]++;
+        xs_[slot] = xs[i];
+        ys_[slot] = ys[i];
+        ids_[slot] = ids ? ids[i] : static_cast<uint32_t>(i);
+    }
+    for (size_t c = cells; c > 0; --c) {
+        start_[c] = start_[c - 1];
+    }
+    start_[0] = 0;
+
+    // самый большой блок из трёх соседних ячеек одной строки
+    maxBlock_ = 0;
+    for (int row = 0; row < rows_; ++row) {
+        const size_t base = static_cast<size_t>(row) * cols_;
+        for (int col = 0; col < cols_; ++col) {
+            const size_t left = base + (col > 0 ? col - 1 : 0);
+            const size_t right = base + (col + 1 < cols_ ? col + 1 : col);
+            maxBlock_ = std::max<size_t>(maxBlock_, start_[right + 1] - start_[left]);
+        }
+    }
+
+    pendingXs_.clear();
+    pendingYs_.clear();
+    pendingIds_.clear();
+}
+
+size_t SpatialGrid::maxCellSize() const {
+    return maxBlock_;
+}
+
+double SpatialGrid::cellSize() const {
+    return cellSize_;
+}
+
+size_t SpatialGrid::cellCount() const {
+    return static_cast<size_t>(cols_) * rows_;
+}
+
+size_t SpatialGrid::cellIndex(int x, int y) const {
+    return static_cast<size_t>(cellCoord(y, rows_)) * cols_ + cellCoord(x, cols_);
+}
+
+int SpatialGrid::cellCoord(int value, int limit) const {
+    int c = static_cast<int>(std::floor(value / cellSize_));
+    return std::clamp(c, 0, limit - 1);
+}
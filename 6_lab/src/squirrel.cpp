@@ -2,10 +2,8 @@
 #include "../include/visitor.h"
 #include <iostream>
 
-const std::string Squirrel::type_ = "Squirrel";
-
 Squirrel::Squirrel(int x, int y, const std::string& name)
-    : Npc(x, y, type_, name) 
+    : Npc(x, y, typeId, name) 
 {
     // конструктор белки
 }
@@ -0,0 +1,437 @@
+#include "../include/streaming_battle.h"
+#include "../include/combat_visitor.h"
+#include "../include/distance_kernel.h"
+#include "../include/npc_parser.h"
+#include "../include/spatial_grid.h"
+#include "../include/string_interner.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// размер куска при чтении входного файла
+const size_t READ_CHUNK = 1 << 20;
+// сколько кусков сливается за один проход
+const size_t MERGE_FAN_IN = 64;
+
+// запись во временных файлах: заголовок и байты имени
+struct RecordHeader {
+    int32_t x;
+    int32_t y;
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t nameLength;
+};
+
+struct Record {
+    RecordHeader header;
+    std::string name;
+};
+
+// временные файлы удаляются при выходе из боя, в том числе по исключению
+class TempFiles {
+public:
+    explicit TempFiles(std::string dir) : dir_(std::move(dir)) {}
+    ~TempFiles() {
+        for (const auto& file : files_) std::remove(file.c_str());
+    }
+    TempFiles(const TempFiles&) = delete;
+    TempFiles& operator=(const TempFiles&) = delete;
+
+    std::string create() {
+        static std::atomic<uint64_t> counter{0};
+        files_.push_back(dir_ + "/npc_stream_" + std::to_string(getpid()) + "_" +
+                         std::to_string(counter++) + ".run");
+        return files_.back();
+    }
+
+    // файл вне каталога dir, удаляемый так же
+    std::string track(std::string file) {
+        files_.push_back(std::move(file));
+        return files_.back();
+    }
+
+    void remove(const std::string& file) {
+        std::remove(file.c_str());
+        files_.erase(std::remove(files_.begin(), files_.end(), file), files_.end());
+    }
+
+private:
+    std::string dir_;
+    std::vector<std::string> files_;
+};
+
+std::ofstream openForWriting(const std::string& filename) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + filename);
+    }
+    return file;
+}
+
+void checkWritten(const std::ofstream& file, const std::string& filename) {
+    if (!file) {
+        throw std::runtime_error("Cannot write to file: " + filename);
+    }
+}
+
+bool readRecord(std::ifstream& file, Record& record) {
+    if (!file.read(reinterpret_cast<char*>(&record.header), sizeof(RecordHeader))) return false;
+    record.name.resize(record.header.nameLength);
+    return static_cast<bool>(file.read(record.name.data(), record.header.nameLength));
+}
+
+void writeRecord(std::ofstream& file, const RecordHeader& header, std::string_view name) {
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(name.data(), static_cast<std::streamsize>(name.size()));
+}
+
+// разбор текстового файла кусками: в памяти только текущий кусок и хвост неполной строки
+template <typename Fn>
+void forEachNpcInFile(const std::string& filename, Fn&& fn) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file for reading: " + filename);
+    }
+    std::vector<char> buffer(READ_CHUNK);
+    size_t carried = 0;
+    while (true) {
+        // строка длиннее буфера - буфер растёт
+        if (carried == buffer.size()) buffer.resize(buffer.size() * 2);
+        file.read(buffer.data() + carried, static_cast<std::streamsize>(buffer.size() - carried));
+        const size_t filled = carried + static_cast<size_t>(file.gcount());
+        const bool last = !file;
+        const std::string_view view(buffer.data(), filled);
+
+        size_t end = filled;
+        if (!last) {
+            const size_t newline = view.rfind('\n');
+            if (newline == std::string_view::npos) {
+                carried = filled;
+                continue;
+            }
+            end = newline + 1;
+        }
+        forEachNpcLine(view.substr(0, end), fn);
+        if (last) break;
+        carried = filled - end;
+        std::memmove(buffer.data(), buffer.data() + end, carried);
+    }
+}
+
+// слияние отсортированных кусков: записи идут по полосам, при равной полосе -
+// в порядке кусков и внутри куска, то есть в порядке входного файла
+template <typename Fn>
+void mergeRuns(const std::vector<std::string>& runs, int64_t stripHeight, Fn&& fn) {
+    std::vector<std::ifstream> readers;
+    std::vector<Record> heads(runs.size());
+    readers.reserve(runs.size());
+
+    using Entry = std::pair<int64_t, size_t>;  // полоса, номер куска
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (size_t r = 0; r < runs.size(); ++r) {
+        readers.emplace_back(runs[r], std::ios::binary);
+        if (!readers.back().is_open()) {
+            throw std::runtime_error("Cannot open file for reading: " + runs[r]);
+        }
+        if (readRecord(readers[r], heads[r])) {
+            queue.push({heads[r].header.y / stripHeight, r});
+        }
+    }
+    while (!queue.empty()) {
+        const size_t r = queue.top().second;
+        queue.pop();
+        fn(heads[r]);
+        if (readRecord(readers[r], heads[r])) {
+            queue.push({heads[r].header.y / stripHeight, r});
+        }
+    }
+}
+
+// NPC одной полосы по столбцам
+struct Strip {
+    int64_t index = -1;
+    std::vector<int> xs, ys;
+    std::vector<NpcType> types;
+    std::vector<uint32_t> nameOffsets{0};
+    std::string names;
+    std::vector<uint8_t> dead;
+
+    size_t size() const { return xs.size(); }
+    bool empty() const { return xs.empty(); }
+
+    // приблизительный объём в памяти вместе с записями сетки
+    size_t bytes() const { return xs.size() * 40 + names.size(); }
+
+    std::string_view name(size_t i) const {
+        return std::string_view(names).substr(nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]);
+    }
+
+    void add(const Record& record) {
+        xs.push_back(record.header.x);
+        ys.push_back(record.header.y);
+        types.push_back(static_cast<NpcType>(record.header.type));
+        names += record.name;
+        nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+        dead.push_back(0);
+    }
+
+    void clear() {
+        index = -1;
+        xs.clear();
+        ys.clear();
+        types.clear();
+        nameOffsets.assign(1, 0);
+        names.clear();
+        dead.clear();
+    }
+};
+
+enum class Outcome : uint8_t { FirstKills, SecondKills, Mutual };
+
+struct Kill {
+    uint32_t first;
+    uint32_t second;
+    Outcome outcome;
+};
+
+}
+
+StreamingReport streamingBattle(const std::string& input, const std::string& output, double range,
+                                int width, int height, const StreamingOptions& options,
+                                const std::function<void(const CombatEvent&)>& emit, uint64_t tick) {
+    StreamingReport report;
+    TempFiles temp(options.tempDir);
+
+    // полоса не ниже дальности: пары в пределах боя лежат в одной или соседних полосах
+    const int64_t stripHeight = static_cast<int64_t>(
+        std::min(std::ceil(std::max(range, 1.0)), static_cast<double>(height) + 1.0));
+
+    // первый проход: куски входа, отсортированные по полосам, уходят на диск
+    struct Ref {
+        int64_t strip;
+        size_t offset;
+    };
+    std::string bytes;
+    std::vector<Ref> refs;
+    std::vector<std::string> runs;
+    const size_t runBudget = std::max<size_t>(options.memoryBudget / 2, 4096);
+
+    auto flushRun = [&]() {
+        if (refs.empty()) return;
+        std::stable_sort(refs.begin(), refs.end(), [](const Ref& a, const Ref& b) { return a.strip < b.strip; });
+        const std::string run = temp.create();
+        std::ofstream file = openForWriting(run);
+        for (const Ref& ref : refs) {
+            RecordHeader header;
+            std::memcpy(&header, bytes.data() + ref.offset, sizeof(header));
+            file.write(bytes.data() + ref.offset, static_cast<std::streamsize>(sizeof(header) + header.nameLength));
+        }
+        file.close();
+        checkWritten(file, run);
+        runs.push_back(run);
+        bytes.clear();
+        refs.clear();
+    };
+
+    forEachNpcInFile(input, [&](const ParsedNpc& npc) {
+        if (npc.x < 0 || npc.x > width || npc.y < 0 || npc.y > height) {
+            throw std::out_of_range("NPC coordinates out of bounds.");
+        }
+        if (npc.name.size() > std::numeric_limits<uint16_t>::max()) {
+            throw std::length_error("NPC name is too long.");
+        }
+        const RecordHeader header{npc.x, npc.y, static_cast<uint8_t>(npc.type), 0,
+                                  static_cast<uint16_t>(npc.name.size())};
+        refs.push_back({npc.y / stripHeight, bytes.size()});
+        bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        bytes.append(npc.name);
+        ++report.npcs;
+        if (bytes.size() + refs.size() * sizeof(Ref) >= runBudget) flushRun();
+    });
+    flushRun();
+    std::string().swap(bytes);
+    std::vector<Ref>().swap(refs);
+    report.runs = runs.size();
+
+    // слишком много кусков для одного слияния - сливаются соседние группы
+    while (runs.size() > MERGE_FAN_IN) {
+        std::vector<std::string> merged;
+        for (size_t begin = 0; begin < runs.size(); begin += MERGE_FAN_IN) {
+            const std::vector<std::string> group(runs.begin() + begin,
+                                                 runs.begin() + std::min(runs.size(), begin + MERGE_FAN_IN));
+            const std::string run = temp.create();
+            std::ofstream file = openForWriting(run);
+            mergeRuns(group, stripHeight, [&](const Record& record) {
+                writeRecord(file, record.header, record.name);
+            });
+            file.close();
+            checkWritten(file, run);
+            for (const auto& used : group) temp.remove(used);
+            merged.push_back(run);
+        }
+        runs.swap(merged);
+    }
+
+    // второй проход: полосы по порядку, в памяти предыдущая и текущая.
+    // Выжившие пишутся во временный файл рядом с output и заменяют его только
+    // после успешного боя: при ошибке output не тронут
+    const std::string partial = temp.track(output + ".partial_" + std::to_string(getpid()));
+    std::ofstream out = openForWriting(partial);
+    const int64_t maxD2 = maxSquaredDistance(range);
+    SpatialGrid grid;
+    std::vector<uint32_t> inRange;
+    std::vector<Kill> kills;
+    Strip previous, current;
+    std::string line;
+
+    auto writeSurvivors = [&](const Strip& strip) {
+        for (size_t i = 0; i < strip.size(); ++i) {
+            if (strip.dead[i]) continue;
+            line.assign(npcTypeName(strip.types[i]));
+            line += ' ';
+            line += strip.name(i);
+            line += ' ';
+            line += std::to_string(strip.xs[i]);
+            line += ' ';
+            line += std::to_string(strip.ys[i]);
+            line += '\n';
+            out.write(line.data(), static_cast<std::streamsize>(line.size()));
+            ++report.survivors;
+        }
+    };
+
+    // бои текущей полосы между собой и с предыдущей; номера в окне: сначала
+    // предыдущая полоса, затем текущая
+    auto fight = [&]() {
+        const bool adjacent = previous.index == current.index - 1;
+        const uint32_t base = adjacent ? static_cast<uint32_t>(previous.size()) : 0;
+        const int64_t bottom = (current.index - 1) * stripHeight;
+        report.peakWindow = std::max(report.peakWindow, base + current.size());
+
+        // ячеек не больше, чем нужно NPC окна: обход пустых ячеек дороже перебора в крупной
+        size_t cells = 64;
+        while (cells < (base + current.size()) * 2 && cells < SpatialGrid::MAX_CELLS) cells *= 2;
+        grid.reset(width, static_cast<int>(2 * stripHeight), range, cells);
+        if (adjacent) {
+            for (uint32_t i = 0; i < previous.size(); ++i) {
+                grid.insert(i, previous.xs[i], static_cast<int>(previous.ys[i] - bottom));
+            }
+        }
+        for (uint32_t i = 0; i < current.size(); ++i) {
+            grid.insert(base + i, current.xs[i], static_cast<int>(current.ys[i] - bottom));
+        }
+        grid.build();
+        inRange.resize(grid.maxCellSize());
+
+        auto type = [&](uint32_t id) { return id < base ? previous.types[id] : current.types[id - base]; };
+        auto name = [&](uint32_t id) { return id < base ? previous.name(id) : current.name(id - base); };
+
+        kills.clear();
+        for (uint32_t k = 0; k < current.size(); ++k) {
+            const uint32_t i = base + k;
+            const int x = current.xs[k];
+            const int y = static_cast<int>(current.ys[k] - bottom);
+            grid.forEachNeighbourCell(x, y, [&](const int* xs, const int* ys, const uint32_t* ids, size_t count) {
+                const size_t found = selectInRange(x, y, xs, ys, count, maxD2, inRange.data());
+                for (size_t f = 0; f < found; ++f) {
+                    const uint32_t j = ids[inRange[f]];
+                    // пары внутри предыдущей полосы уже разобраны, внутри текущей берёт меньший номер
+                    if (j == i || (j >= base && j < i)) continue;
+                    const bool iKillsJ = CombatVisitor::canKill(type(i), type(j));
+                    const bool jKillsI = CombatVisitor::canKill(type(j), type(i));
+                    if (!iKillsJ && !jKillsI) continue;
+
+                    Outcome outcome = iKillsJ && jKillsI ? Outcome::Mutual
+                                    : iKillsJ ? Outcome::FirstKills : Outcome::SecondKills;
+                    if (name(i) < name(j)) {
+                        kills.push_back({i, j, outcome});
+                    } else {
+                        if (outcome != Outcome::Mutual) {
+                            outcome = outcome == Outcome::FirstKills ? Outcome::SecondKills : Outcome::FirstKills;
+                        }
+                        kills.push_back({j, i, outcome});
+                    }
+                }
+            });
+        }
+
+        std::sort(kills.begin(), kills.end(), [&](const Kill& a, const Kill& b) {
+            if (a.first != b.first) return name(a.first) < name(b.first);
+            return name(a.second) < name(b.second);
+        });
+        auto markDead = [&](uint32_t id) {
+            if (id < base) previous.dead[id] = 1;
+            else current.dead[id - base] = 1;
+        };
+        auto position = [&](uint32_t id, int& x, int& y) {
+            x = id < base ? previous.xs[id] : current.xs[id - base];
+            y = id < base ? previous.ys[id] : current.ys[id - base];
+        };
+        StringInterner& interner = StringInterner::global();
+        for (const Kill& kill : kills) {
+            uint32_t attacker = kill.first;
+            uint32_t defender = kill.second;
+            CombatEventKind kind = CombatEventKind::Kill;
+            if (kill.outcome == Outcome::Mutual) {
+                kind = CombatEventKind::MutualKill;
+                markDead(attacker);
+            } else if (kill.outcome == Outcome::SecondKills) {
+                std::swap(attacker, defender);
+            }
+            markDead(defender);
+
+            int x, y;
+            position(defender, x, y);
+            emit(CombatEvent{kind, type(attacker), type(defender), interner.intern(name(attacker)),
+                             interner.intern(name(defender)), x, y, tick});
+        }
+        report.kills += kills.size();
+    };
+
+    // полоса готова: дальше в окне она может быть только предыдущей
+    auto settle = [&]() {
+        if (current.empty()) return;
+        ++report.strips;
+        if (previous.index != current.index - 1) {
+            writeSurvivors(previous);
+            previous.clear();
+        }
+        fight();
+        writeSurvivors(previous);
+        std::swap(previous, current);
+        current.clear();
+    };
+
+    mergeRuns(runs, stripHeight, [&](const Record& record) {
+        const int64_t strip = record.header.y / stripHeight;
+        if (strip != current.index) {
+            settle();
+            current.index = strip;
+        }
+        current.add(record);
+        if (previous.bytes() + current.bytes() > options.memoryBudget) {
+            throw std::runtime_error("NPC strip does not fit into the streaming memory budget.");
+        }
+    });
+    settle();
+    writeSurvivors(previous);
+
+    out.close();
+    checkWritten(out, partial);
+    if (std::rename(partial.c_str(), output.c_str()) != 0) {
+        throw std::runtime_error("Cannot write to file: " + output);
+    }
+    return report;
+}
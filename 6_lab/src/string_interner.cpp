@@ -0,0 +1,145 @@
+#include "../include/string_interner.h"
+#include <cstring>
+
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+StringInterner::StringInterner()
+    : segments_(new std::atomic<Entry*>[SEGMENT_COUNT]) {
+    for (size_t i = 0; i < SEGMENT_COUNT; ++i) {
+        segments_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+StringInterner::~StringInterner() {
+    for (size_t i = 0; i < SEGMENT_COUNT; ++i) {
+        delete[] segments_[i].load(std::memory_order_relaxed);
+    }
+}
+
+StringInterner& StringInterner::global() {
+    static StringInterner instance;
+    return instance;
+}
+
+// FNV-1a
+uint32_t StringInterner::hashOf(std::string_view str) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : str) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t StringInterner::intern(std::string_view str) {
+    const uint32_t hash = hashOf(str);
+    Shard& shard = shards_[hash % SHARD_COUNT];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    uint32_t id = findIn(shard, str, hash);
+    if (id != npos) return id;
+
+    if ((shard.used + 1) * 2 > shard.slots.size()) {
+        grow(shard);
+    }
+
+    id = nextId_.fetch_add(1, std::memory_order_relaxed);
+    Entry& e = allocateEntry(id);
+    e.data = storeChars(shard, str);
+    e.size = static_cast<uint32_t>(str.size());
+    e.hash = hash;
+
+    const size_t mask = shard.slots.size() - 1;
+    size_t slot = (hash / SHARD_COUNT) & mask;
+    while (shard.slots[slot] != npos) {
+        slot = (slot + 1) & mask;
+    }
+    shard.slots[slot] = id;
+    ++shard.used;
+    return id;
+}
+
+uint32_t StringInterner::find(std::string_view str) const {
+    const uint32_t hash = hashOf(str);
+    const Shard& shard = shards_[hash % SHARD_COUNT];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return findIn(shard, str, hash);
+}
+
+std::string_view StringInterner::view(uint32_t id) const {
+    const Entry& e = entry(id);
+    return std::string_view(e.data, e.size);
+}
+
+size_t StringInterner::size() const {
+    return nextId_.load(std::memory_order_relaxed);
+}
+
+const StringInterner::Entry& StringInterner::entry(uint32_t id) const {
+    Entry* segment = segments_[id >> SEGMENT_BITS].load(std::memory_order_acquire);
+    return segment[id & (SEGMENT_SIZE - 1)];
+}
+
+// сегменты выделяются один раз и не перемещаются
+StringInterner::Entry& StringInterner::allocateEntry(uint32_t id) {
+    std::atomic<Entry*>& slot = segments_[id >> SEGMENT_BITS];
+    Entry* segment = slot.load(std::memory_order_acquire);
+    if (segment == nullptr) {
+        Entry* fresh = new Entry[SEGMENT_SIZE];
+        if (slot.compare_exchange_strong(segment, fresh, std::memory_order_acq_rel)) {
+            segment = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+    return segment[id & (SEGMENT_SIZE - 1)];
+}
+
+const char* StringInterner::storeChars(Shard& shard, std::string_view str) {
+    if (str.size() > shard.left) {
+        // длинные строки получают отдельный блок, текущий блок сохраняется
+        if (str.size() > CHUNK_SIZE / 4) {
+            shard.chunks.emplace_back(new char[str.size()]);
+            std::memcpy(shard.chunks.back().get(), str.data(), str.size());
+            return shard.chunks.back().get();
+        }
+        shard.chunks.emplace_back(new char[CHUNK_SIZE]);
+        shard.cursor = shard.chunks.back().get();
+        shard.left = CHUNK_SIZE;
+    }
+    char* data = shard.cursor;
+    if (!str.empty()) {
+        std::memcpy(data, str.data(), str.size());
+    }
+    shard.cursor += str.size();
+    shard.left -= str.size();
+    return data;
+}
+
+uint32_t StringInterner::findIn(const Shard& shard, std::string_view str, uint32_t hash) const {
+    if (shard.slots.empty()) return npos;
+
+    const size_t mask = shard.slots.size() - 1;
+    size_t slot = (hash / SHARD_COUNT) & mask;
+    while (shard.slots[slot] != npos) {
+        const Entry& e = entry(shard.slots[slot]);
+        if (e.hash == hash && std::string_view(e.data, e.size) == str) {
+            return shard.slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return npos;
+}
+
+void StringInterner::grow(Shard& shard) {
+    std::vector<uint32_t> slots(shard.slots.empty() ? 64 : shard.slots.size() * 2, npos);
+    const size_t mask = slots.size() - 1;
+    for (uint32_t id : shard.slots) {
+        if (id == npos) continue;
+        size_t slot = (entry(id).hash / SHARD_COUNT) & mask;
+        while (slots[slot] != npos) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = id;
+    }
+    shard.slots.swap(slots);
+}
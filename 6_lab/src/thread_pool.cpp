@@ -0,0 +1,114 @@
+#include "../include/thread_pool.h"
+#include <algorithm>
+#include <exception>
+
+ThreadPool::ThreadPool(size_t threads) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wakeUp_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return workers_.size();
+}
+
+size_t ThreadPool::chunkCount(size_t count, size_t grain) {
+    grain = std::max<size_t>(grain, 1);
+    return (count + grain - 1) / grain;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain,
+                             const std::function<void(size_t, size_t, size_t)>& fn) {
+    grain = std::max<size_t>(grain, 1);
+    const size_t chunks = chunkCount(count, grain);
+    if (chunks == 0) return;
+
+    std::atomic<size_t> remaining{chunks};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        push([&, chunk]() {
+            try {
+                fn(chunk, chunk * grain, std::min(count, (chunk + 1) * grain));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) error = std::current_exception();
+            }
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+
+    // вызывающий поток помогает, пока его блоки не закончатся
+    while (remaining.load(std::memory_order_acquire) != 0) {
+        if (!tryRun(0)) {
+            std::this_thread::yield();
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::push(Task task) {
+    Queue& queue = *queues_[nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size()];
+    pending_.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    wakeUp_.notify_one();
+}
+
+// своя очередь берётся с головы, чужие - с хвоста
+bool ThreadPool::tryRun(size_t home) {
+    Task task;
+    for (size_t i = 0; i < queues_.size() && !task; ++i) {
+        Queue& queue = *queues_[(home + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+    if (!task) return false;
+
+    pending_.fetch_sub(1, std::memory_order_acq_rel);
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    while (true) {
+        if (tryRun(index)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wakeUp_.wait(lock, [this]() {
+            return stopping_ || pending_.load(std::memory_order_acquire) != 0;
+        });
+        if (stopping_ && pending_.load(std::memory_order_acquire) == 0) return;
+    }
+}
@@ -0,0 +1,171 @@
+#include "../include/world_generator.h"
+#include "../include/arena.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+// отдельный поток чисел для центров скоплений, чтобы reset не зависел от них
+static constexpr uint64_t CENTERS_SALT = 0x9e3779b97f4a7c15ull;
+
+static uint64_t splitMix(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+WorldGenerator::WorldGenerator(WorldSpec spec) : spec_(std::move(spec)) {
+    if (spec_.width < 0 || spec_.height < 0) {
+        throw std::invalid_argument("World dimensions must not be negative.");
+    }
+    double total = 0.0;
+    for (size_t t = 0; t < NPC_TYPE_COUNT; ++t) {
+        const double weight = spec_.typeWeights[t];
+        if (!(weight >= 0.0) || std::isinf(weight)) {
+            throw std::invalid_argument("Type weights must be finite and not negative.");
+        }
+        total += weight;
+        cumulative_[t] = total;
+    }
+    if (total <= 0.0) {
+        throw std::invalid_argument("At least one type weight must be positive.");
+    }
+    if (spec_.namePrefix.empty() ||
+        spec_.namePrefix.find_first_of(" \t\r\n") != std::string::npos) {
+        throw std::invalid_argument("Name prefix must be a non-empty word.");
+    }
+
+    switch (spec_.distribution) {
+    case WorldDistribution::Uniform:
+        break;
+    case WorldDistribution::Clustered: {
+        if (spec_.clusters == 0 || spec_.clusterRadius < 0) {
+            throw std::invalid_argument("Clustered world needs clusters and a non-negative radius.");
+        }
+        // дальше стороны мира скопление всё равно упирается в край
+        spec_.clusterRadius = std::min(spec_.clusterRadius, std::max(spec_.width, spec_.height));
+        uint64_t state = spec_.seed ^ CENTERS_SALT;
+        for (size_t c = 0; c < spec_.clusters; ++c) {
+            const int x = static_cast<int>(splitMix(state) % (static_cast<uint64_t>(spec_.width) + 1));
+            const int y = static_cast<int>(splitMix(state) % (static_cast<uint64_t>(spec_.height) + 1));
+            centers_.emplace_back(x, y);
+        }
+        break;
+    }
+    case WorldDistribution::AllInRange: {
+        if (!(spec_.range >= 0.0)) {
+            throw std::invalid_argument("Range must not be negative.");
+        }
+        // в квадрате со стороной s любые две точки не дальше s * sqrt(2)
+        const double side = std::floor(spec_.range / std::sqrt(2.0));
+        boxSide_ = static_cast<int>(std::min<double>(side, std::min(spec_.width, spec_.height)));
+        boxX_ = (spec_.width - boxSide_) / 2;
+        boxY_ = (spec_.height - boxSide_) / 2;
+        break;
+    }
+    }
+
+    name_.reserve(spec_.namePrefix.size() + 20);
+    reset();
+}
+
+void WorldGenerator::reset() {
+    state_ = spec_.seed;
+    index_ = 0;
+}
+
+uint64_t WorldGenerator::random() {
+    return splitMix(state_);
+}
+
+int64_t WorldGenerator::randomInt(int64_t from, int64_t to) {
+    const uint64_t span = static_cast<uint64_t>(to - from) + 1;
+    return from + static_cast<int64_t>(random() % span);
+}
+
+bool WorldGenerator::next(GeneratedNpc& npc) {
+    if (index_ >= spec_.count) return false;
+
+    const double pick = static_cast<double>(random() >> 11) * 0x1.0p-53 * cumulative_.back();
+    size_t type = 0;
+    while (type + 1 < NPC_TYPE_COUNT && !(pick < cumulative_[type])) ++type;
+    npc.type = static_cast<NpcType>(type);
+
+    switch (spec_.distribution) {
+    case WorldDistribution::Uniform:
+        npc.x = static_cast<int>(randomInt(0, spec_.width));
+        npc.y = static_cast<int>(randomInt(0, spec_.height));
+        break;
+    case WorldDistribution::Clustered: {
+        const auto& center = centers_[random() % centers_.size()];
+        const int64_t r = spec_.clusterRadius;
+        npc.x = static_cast<int>(std::clamp<int64_t>(randomInt(center.first - r, center.first + r), 0, spec_.width));
+        npc.y = static_cast<int>(std::clamp<int64_t>(randomInt(center.second - r, center.second + r), 0, spec_.height));
+        break;
+    }
+    case WorldDistribution::AllInRange:
+        npc.x = static_cast<int>(randomInt(boxX_, boxX_ + boxSide_));
+        npc.y = static_cast<int>(randomInt(boxY_, boxY_ + boxSide_));
+        break;
+    }
+
+    name_.assign(spec_.namePrefix);
+    name_ += std::to_string(index_);
+    npc.name = name_;
+    ++index_;
+    return true;
+}
+
+void generateWorld(const WorldSpec& spec, Arena& arena) {
+    WorldGenerator generator(spec);
+    GeneratedNpc npc;
+    while (generator.next(npc)) {
+        arena.createAndAddNpc(std::string(npcTypeName(npc.type)), std::string(npc.name), npc.x, npc.y);
+    }
+}
+
+void generateWorldFile(const WorldSpec& spec, const std::string& filename, SnapshotFormat format) {
+    WorldGenerator generator(spec);
+
+    if (format == SnapshotFormat::Binary) {
+        // столбцы снимка пишутся отдельными проходами по одному и тому же миру
+        writeBinarySnapshot(filename, [&generator](const SnapshotSink& sink) {
+            generator.reset();
+            GeneratedNpc npc;
+            while (generator.next(npc)) {
+                sink(npc.type, npc.name, npc.x, npc.y);
+            }
+        });
+        return;
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + filename);
+    }
+    std::string buffer;
+    const size_t bufferSize = 1 << 20;
+    buffer.reserve(bufferSize + 64);
+    auto drain = [&]() {
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if (!file) {
+            throw std::runtime_error("Cannot write to file: " + filename);
+        }
+        buffer.clear();
+    };
+
+    GeneratedNpc npc;
+    while (generator.next(npc)) {
+        buffer += npcTypeName(npc.type);
+        buffer += ' ';
+        buffer += npc.name;
+        buffer += ' ';
+        buffer += std::to_string(npc.x);
+        buffer += ' ';
+        buffer += std::to_string(npc.y);
+        buffer += '\n';
+        if (buffer.size() >= bufferSize) drain();
+    }
+    drain();
+}
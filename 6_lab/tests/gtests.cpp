@@ -8,8 +8,35 @@
 #include "../include/knight.h"
 #include "../include/pegasus.h"
 #include "../include/squirrel.h"
+#include "../include/spatial_grid.h"
+#include "../include/npc_store.h"
+#include "../include/string_interner.h"
+#include "../include/thread_pool.h"
+#include "../include/distance_kernel.h"
+#include "../include/event_bus.h"
+#include "../include/combat_event.h"
+#include "../include/snapshot.h"
+#include "../include/npc_parser.h"
+#include "../include/npc_pool.h"
+#include "../include/world_generator.h"
+#include "../include/arena_stats.h"
+#include "../include/sharded_grid.h"
+#include "../include/streaming_battle.h"
+#include "../include/arena_snapshot.h"
+#include <sstream>
 #include <memory>
 #include <fstream>
+#include <map>
+#include <set>
+#include <limits>
+#include <tuple>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <type_traits>
+#include <filesystem>
 
 // тесты создания npc
 TEST(NpcTest, CreateKnight) {
@@ -39,6 +66,25 @@ TEST(NpcTest, CreateSquirrel) {
     EXPECT_EQ(squirrel.getType(), "Squirrel");
 }
 
+TEST(NpcTest, NameIsInterned) {
+    std::string_view name;
+    uint32_t id;
+    {
+        Knight knight(1, 2, std::string("Gawain"));
+        name = knight.getName();
+        id = knight.getNameId();
+        Squirrel squirrel(3, 4, "Gawain");
+        EXPECT_EQ(squirrel.getNameId(), id);
+    }
+    // строка имени живёт в интернере и после NPC
+    EXPECT_EQ(name, "Gawain");
+    EXPECT_EQ(StringInterner::global().find("Gawain"), id);
+
+    Arena arena;
+    arena.addNpc(NpcFactory::createNpc("Pegasus", "Gawain", 5, 5));
+    EXPECT_THROW(arena.createAndAddNpc("Knight", "Gawain", 1, 1), std::invalid_argument);
+}
+
 // Distance calculation tests
 TEST(NpcTest, DistanceCalculation) {
     Knight knight1(0, 0, "Knight1");
@@ -63,6 +109,15 @@ TEST(NpcTest, DistanceSymmetric) {
     EXPECT_DOUBLE_EQ(pegasus.distanceTo(knight), knight.distanceTo(pegasus));
 }
 
+TEST(NpcTest, DistanceAcrossHugeMap) {
+    // квадрат разности больше INT_MAX уже при 46341
+    Knight near(0, 0, "HugeOrigin");
+    Knight far(46341, 0, "HugeEdge");
+    Knight corner(1000000, 1000000, "HugeCorner");
+    EXPECT_DOUBLE_EQ(near.distanceTo(far), 46341.0);
+    EXPECT_DOUBLE_EQ(near.distanceTo(corner), std::sqrt(2.0) * 1000000.0);
+}
+
 // Boundary coordinates tests
 TEST(NpcTest, BoundaryCoordinates) {
     Knight knight1(0, 0, "MinCorner");
@@ -168,7 +223,7 @@ TEST(ArenaTest, CreateArena) {
 
 TEST(ArenaTest, CreateArenaInvalidSize) {
     EXPECT_THROW({
-        Arena arena(600, 600);  // Р‘РѕР»СЊС€Рµ РјР°РєСЃРёРјСѓРјР°
+        Arena arena(MAX_WIDTH + 1, MAX_HEIGHT + 1);  // Р‘РѕР»СЊС€Рµ РјР°РєСЃРёРјСѓРјР°
     }, std::out_of_range);
 }
 
@@ -216,6 +271,59 @@ TEST(ArenaTest, AddNpcOutOfBounds) {
     }, std::out_of_range);
 }
 
+TEST(ArenaTest, AddNpcsBatch) {
+    Arena arena(500, 500);
+    std::vector<std::unique_ptr<Npc>> npcs;
+    npcs.push_back(NpcFactory::createNpc("Knight", "Knight1", 100, 100));
+    npcs.push_back(NpcFactory::createNpc("Pegasus", "Pegasus1", 200, 200));
+    arena.addNpcs(npcs);
+    EXPECT_EQ(arena.getNpcCount(), 2);
+
+    std::vector<NpcSpawn> wave;
+    for (int i = 0; i < 1000; ++i) {
+        wave.push_back({"Squirrel", "Squirrel" + std::to_string(i), i % 500, i / 2});
+    }
+    arena.createAndAddNpcs(wave);
+    EXPECT_EQ(arena.getNpcCount(), 1002);
+    EXPECT_THROW(arena.createAndAddNpc("Knight", "Squirrel999", 1, 1), std::invalid_argument);
+}
+
+TEST(ArenaTest, AddNpcsBatchIsAllOrNothing) {
+    Arena arena(500, 500);
+    arena.createAndAddNpc("Knight", "Existing", 10, 10);
+
+    // ошибка первой по порядку строки, арена не меняется
+    auto errorOf = [&arena](const std::vector<NpcSpawn>& wave) -> std::string {
+        try {
+            arena.createAndAddNpcs(wave);
+        } catch (const std::exception& e) {
+            return e.what();
+        }
+        return "none";
+    };
+    std::vector<NpcSpawn> wave;
+    for (int i = 0; i < 600; ++i) {
+        wave.push_back({"Knight", "Wave" + std::to_string(i), i % 500, 1});
+    }
+    wave[400].x = -1;
+    wave[300].name = "Wave7";
+    EXPECT_EQ(errorOf(wave), "NPC with this name already exists: Wave7 (batch row 300)");
+    wave[300].name = "Existing";
+    EXPECT_EQ(errorOf(wave), "NPC with this name already exists: Existing (batch row 300)");
+    wave[300].name = "Wave300";
+    EXPECT_EQ(errorOf(wave), "NPC coordinates out of bounds: Wave400 (batch row 400)");
+    wave[500].type = "Dragon";
+    EXPECT_EQ(errorOf(wave), "NPC coordinates out of bounds: Wave400 (batch row 400)");
+    wave[400].x = 0;
+    EXPECT_EQ(errorOf(wave), "Unknown NPC type: Dragon (batch row 500)");
+    EXPECT_THROW(arena.createAndAddNpcs(wave), std::invalid_argument);
+    EXPECT_EQ(arena.getNpcCount(), 1);
+
+    wave[500].type = "Pegasus";
+    arena.createAndAddNpcs(wave);
+    EXPECT_EQ(arena.getNpcCount(), 601);
+}
+
 TEST(ArenaTest, ClearArena) {
     Arena arena;
     
@@ -401,6 +509,22 @@ TEST(CombatTest, SquirrelVsSquirrel) {
     EXPECT_FALSE(visitor.canKill(squirrel1.get(), squirrel2.get()));
 }
 
+TEST(CombatTest, CanFightIsSymmetricKillTable) {
+    // пары, которые бой пропускает без проверки дальности
+    EXPECT_FALSE(CombatVisitor::canFight(NpcType::Knight, NpcType::Knight));
+    EXPECT_FALSE(CombatVisitor::canFight(NpcType::Knight, NpcType::Pegasus));
+    EXPECT_FALSE(CombatVisitor::canFight(NpcType::Pegasus, NpcType::Pegasus));
+    EXPECT_TRUE(CombatVisitor::canFight(NpcType::Squirrel, NpcType::Knight));
+    EXPECT_TRUE(CombatVisitor::canFight(NpcType::Pegasus, NpcType::Squirrel));
+    for (size_t a = 0; a < NPC_TYPE_COUNT; ++a) {
+        for (size_t b = 0; b < NPC_TYPE_COUNT; ++b) {
+            const auto first = static_cast<NpcType>(a), second = static_cast<NpcType>(b);
+            EXPECT_EQ(CombatVisitor::canFight(first, second),
+                      CombatVisitor::canKill(first, second) || CombatVisitor::canKill(second, first));
+        }
+    }
+}
+
 // Arena battle mode tests
 TEST(CombatTest, BattleOutOfRange) {
     Arena arena;
@@ -627,3 +751,1583 @@ TEST(FileLoadingTest, BattleWithLoadedNpcs) {
     
     EXPECT_GE(arena.getNpcCount(), 1);  // РҐРѕС‚СЏ Р±С‹ РєС‚Рѕ-С‚Рѕ РґРѕР»Р¶РµРЅ РІС‹Р¶РёС‚СЊ
 }
+
+// тесты пространственной сетки: результат должен совпадать с полным перебором пар
+class RecordingObserver : public TextObserver {
+public:
+    using TextObserver::notify;
+
+    std::vector<std::string> events;
+
+    void notify(const std::string& event) override {
+        events.push_back(event);
+    }
+};
+
+struct NpcSpec {
+    std::string type;
+    std::string name;
+    int x, y;
+};
+
+static std::vector<NpcSpec> makeRandomWorld(size_t count, int size, unsigned seed) {
+    static const char* types[] = {"Knight", "Squirrel", "Pegasus"};
+    std::vector<NpcSpec> world;
+    unsigned state = seed;
+    auto next = [&state]() {
+        state = state * 1103515245u + 12345u;
+        return (state >> 8) & 0xFFFFFF;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        world.push_back({types[next() % 3], "npc" + std::to_string(i),
+                         static_cast<int>(next() % (size + 1)),
+                         static_cast<int>(next() % (size + 1))});
+    }
+    return world;
+}
+
+// эталонный полный перебор всех пар в порядке имён
+static std::vector<std::string> bruteForceBattle(const std::vector<NpcSpec>& world, double range,
+                                                 std::vector<std::string>& survivors) {
+    std::map<std::string, std::unique_ptr<Npc>> npcs;
+    for (const auto& spec : world) {
+        npcs[spec.name] = NpcFactory::createNpc(spec.type, spec.name, spec.x, spec.y);
+    }
+    CombatVisitor visitor;
+    std::vector<std::string> events;
+    std::set<std::string> dead;
+    for (auto& [name1, npc1] : npcs) {
+        for (auto& [name2, npc2] : npcs) {
+            if (name1 >= name2) continue;
+            if (npc1->distanceTo(*npc2) > range) continue;
+            bool a = visitor.canKill(npc1.get(), npc2.get());
+            bool b = visitor.canKill(npc2.get(), npc1.get());
+            if (a && b) {
+                events.push_back(name1 + " (" + std::string(npc1->getType()) + ") and " + name2 + " (" +
+                                 std::string(npc2->getType()) + ") killed each other");
+                dead.insert(name1);
+                dead.insert(name2);
+            } else if (a) {
+                events.push_back(name1 + " (" + std::string(npc1->getType()) + ") killed " + name2 + " (" +
+                                 std::string(npc2->getType()) + ")");
+                dead.insert(name2);
+            } else if (b) {
+                events.push_back(name2 + " (" + std::string(npc2->getType()) + ") killed " + name1 + " (" +
+                                 std::string(npc1->getType()) + ")");
+                dead.insert(name1);
+            }
+        }
+    }
+    for (const auto& [name, npc] : npcs) {
+        if (!dead.count(name)) survivors.push_back(name);
+    }
+    return events;
+}
+
+static std::vector<std::string> savedNames(const Arena& arena) {
+    const std::string filename = "test_grid_survivors.txt";
+    arena.saveToFile(filename);
+    std::ifstream file(filename);
+    std::vector<std::string> names;
+    std::string type, name;
+    int x, y;
+    while (file >> type >> name >> x >> y) {
+        names.push_back(name);
+    }
+    file.close();
+    std::remove(filename.c_str());
+    return names;
+}
+
+TEST(SpatialGridTest, MatchesBruteForce) {
+    for (double range : {0.0, 3.0, 17.5, 60.0, 1000.0}) {
+        auto world = makeRandomWorld(400, 200, 42);
+
+        Arena arena(200, 200);
+        auto observer = std::make_shared<RecordingObserver>();
+        arena.addObserver(observer);
+        for (const auto& spec : world) {
+            arena.createAndAddNpc(spec.type, spec.name, spec.x, spec.y);
+        }
+        arena.startBattle(range);
+
+        std::vector<std::string> survivors;
+        auto expected = bruteForceBattle(world, range, survivors);
+
+        EXPECT_EQ(observer->events, expected) << "range " << range;
+        EXPECT_EQ(savedNames(arena), survivors) << "range " << range;
+    }
+}
+
+TEST(SpatialGridTest, NeighbourCellsCoverRange) {
+    SpatialGrid grid;
+    grid.reset(500, 500, 10.0);
+    grid.insert(0, 0, 0);
+    grid.insert(1, 10, 0);
+    grid.insert(2, 25, 0);
+    grid.insert(3, 500, 500);
+    grid.build();
+
+    std::vector<uint32_t> found;
+    grid.forEachNeighbour(0, 0, [&](uint32_t id, int, int) { found.push_back(id); });
+    std::sort(found.begin(), found.end());
+
+    // ячейка не меньше дальности: соседи в пределах 10 обязательно найдены
+    EXPECT_GE(grid.cellSize(), 10.0);
+    EXPECT_TRUE(std::find(found.begin(), found.end(), 1) != found.end());
+    EXPECT_TRUE(std::find(found.begin(), found.end(), 3) == found.end());
+}
+
+TEST(SpatialGridTest, NegativeRangeNoFights) {
+    Arena arena;
+    arena.addNpc(NpcFactory::createNpc("Knight", "Knight1", 100, 100));
+    arena.addNpc(NpcFactory::createNpc("Squirrel", "Squirrel1", 100, 100));
+
+    arena.startBattle(-1.0);
+
+    EXPECT_EQ(arena.getNpcCount(), 2);
+}
+
+// тесты хранилища NPC по столбцам
+TEST(StringInternerTest, SameStringSameId) {
+    StringInterner interner;
+    uint32_t a = interner.intern("Lancelot");
+    uint32_t b = interner.intern("Arthur");
+
+    EXPECT_NE(a, b);
+    EXPECT_EQ(interner.intern("Lancelot"), a);
+    EXPECT_EQ(interner.find("Arthur"), b);
+    EXPECT_EQ(interner.find("Merlin"), StringInterner::npos);
+    EXPECT_EQ(interner.view(a), "Lancelot");
+    EXPECT_EQ(interner.size(), 2);
+}
+
+TEST(StringInternerTest, ManyStringsStayValid) {
+    StringInterner interner;
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 20000; ++i) {
+        ids.push_back(interner.intern("name" + std::to_string(i)));
+    }
+    for (int i = 0; i < 20000; ++i) {
+        EXPECT_EQ(interner.view(ids[i]), "name" + std::to_string(i));
+    }
+}
+
+TEST(NpcStoreTest, InsertFindErase) {
+    NpcStore store;
+    for (uint32_t id = 0; id < 100; ++id) {
+        store.insert(id, id % 2 ? NpcType::Knight : NpcType::Squirrel, static_cast<int>(id), static_cast<int>(id) * 2);
+    }
+    EXPECT_EQ(store.size(), 100);
+    EXPECT_EQ(store.find(42), 42u);
+
+    // на место удалённой строки переезжает последняя
+    store.erase(10);
+    EXPECT_EQ(store.size(), 99);
+    EXPECT_EQ(store.find(10), NpcStore::npos);
+    EXPECT_EQ(store.find(99), 10u);
+    EXPECT_EQ(store.x()[10], 99);
+    EXPECT_EQ(store.y()[10], 198);
+
+    for (uint32_t id = 0; id < 100; ++id) {
+        if (id == 10) continue;
+        uint32_t row = store.find(id);
+        ASSERT_NE(row, NpcStore::npos);
+        EXPECT_EQ(store.nameId()[row], id);
+    }
+
+    store.clear();
+    EXPECT_EQ(store.size(), 0);
+    EXPECT_EQ(store.find(42), NpcStore::npos);
+}
+
+TEST(NpcStoreTest, EraseMarked) {
+    auto check = [](const std::set<uint32_t>& removed) -> NpcStore {
+        NpcStore store;
+        for (uint32_t id = 0; id < 1000; ++id) {
+            store.insert(id, NpcType::Pegasus, static_cast<int>(id), 0);
+        }
+        std::vector<uint64_t> marked(1000 / 64 + 1, 0);
+        for (uint32_t row : removed) marked[row / 64] |= uint64_t{1} << (row % 64);
+
+        EXPECT_EQ(store.eraseMarked(marked), removed.size());
+        EXPECT_EQ(store.size(), 1000 - removed.size());
+        for (uint32_t id = 0; id < 1000; ++id) {
+            const uint32_t row = store.find(id);
+            if (removed.count(id)) {
+                EXPECT_EQ(row, NpcStore::npos);
+            } else {
+                EXPECT_TRUE(row != NpcStore::npos && store.x()[row] == static_cast<int>(id)) << id;
+            }
+        }
+        return store;
+    };
+
+    // несколько удалений - перенос последних строк
+    check({0, 63, 64, 500, 999});
+
+    // массовое удаление - сжатие с сохранением порядка выживших
+    std::set<uint32_t> most;
+    for (uint32_t id = 0; id < 1000; ++id) {
+        if (id % 3) most.insert(id);
+    }
+    NpcStore survivors = check(most);
+    for (uint32_t row = 0; row < survivors.size(); ++row) {
+        EXPECT_EQ(survivors.nameId()[row], row * 3);
+    }
+}
+
+TEST(NpcStoreTest, ArenaPrintsInNameOrder) {
+    Arena arena;
+    arena.createAndAddNpc("Squirrel", "Zed", 10, 20);
+    arena.createAndAddNpc("Knight", "Alpha", 30, 40);
+
+    testing::internal::CaptureStdout();
+    arena.printAllNpcs();
+    std::string output = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(output, "NPC [Knight] Alpha @ (30, 40)\nNPC [Squirrel] Zed @ (10, 20)\n");
+}
+
+// тесты параллельного боя
+TEST(ThreadPoolTest, ParallelForCoversRange) {
+    ThreadPool pool(4);
+    std::vector<int> hits(10000, 0);
+    pool.parallelFor(hits.size(), 128, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) hits[i]++;
+    });
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), 10000);
+    EXPECT_EQ(ThreadPool::chunkCount(10000, 128), 79);
+}
+
+TEST(ThreadPoolTest, ParallelForRethrows) {
+    ThreadPool pool(2);
+    EXPECT_THROW({
+        pool.parallelFor(100, 10, [](size_t chunk, size_t, size_t) {
+            if (chunk == 3) throw std::runtime_error("chunk failed");
+        });
+    }, std::runtime_error);
+}
+
+TEST(ParallelBattleTest, MatchesSequential) {
+    auto world = makeRandomWorld(20000, 500, 7);
+
+    auto run = [&](ExecutionPolicy policy) {
+        Arena arena;
+        arena.setThreadCount(4);
+        auto observer = std::make_shared<RecordingObserver>();
+        arena.addObserver(observer);
+        for (const auto& spec : world) {
+            arena.createAndAddNpc(spec.type, spec.name, spec.x, spec.y);
+        }
+        arena.startBattle(4.0, policy);
+        return std::make_pair(observer->events, savedNames(arena));
+    };
+
+    auto sequential = run(ExecutionPolicy::Sequential);
+    auto parallel = run(ExecutionPolicy::Parallel);
+
+    EXPECT_FALSE(sequential.first.empty());
+    EXPECT_EQ(parallel.first, sequential.first);
+    EXPECT_EQ(parallel.second, sequential.second);
+}
+
+// тесты ядра проверки дальности
+TEST(DistanceKernelTest, MaxSquaredDistanceMatchesSqrt) {
+    for (double range : {0.0, 1.0, 1.5, 7.07, 70.71, 100.0, 141.42135623730951}) {
+        int64_t k = maxSquaredDistance(range);
+        EXPECT_LE(std::sqrt(static_cast<double>(k)), range);
+        EXPECT_GT(std::sqrt(static_cast<double>(k + 1)), range);
+    }
+    EXPECT_LT(maxSquaredDistance(-1.0), 0);
+}
+
+TEST(DistanceKernelTest, AllIsaAgreeWithDistanceTo) {
+    auto world = makeRandomWorld(1000, 500, 3);
+    std::vector<int> xs, ys;
+    for (const auto& spec : world) {
+        xs.push_back(spec.x);
+        ys.push_back(spec.y);
+    }
+    Knight attacker(250, 250, "Attacker");
+
+    for (double range : {0.0, 35.0, 99.5, 100.0, 250.0}) {
+        std::vector<uint32_t> expected;
+        for (size_t i = 0; i < world.size(); ++i) {
+            Knight defender(xs[i], ys[i], "Defender");
+            if (attacker.distanceTo(defender) <= range) expected.push_back(static_cast<uint32_t>(i));
+        }
+
+        for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::Sse2, KernelIsa::Avx2}) {
+            std::vector<uint32_t> out(xs.size());
+            size_t found = selectInRange(250, 250, xs.data(), ys.data(), xs.size(),
+                                         maxSquaredDistance(range), out.data(), isa);
+            out.resize(found);
+            EXPECT_EQ(out, expected) << kernelIsaName(isa) << " range " << range;
+        }
+    }
+}
+
+// тесты таблицы убийств
+TEST(KillMatrixTest, MatchesRules) {
+    static_assert(CombatVisitor::canKill(NpcType::Knight, NpcType::Squirrel));
+    static_assert(CombatVisitor::canKill(NpcType::Squirrel, NpcType::Pegasus));
+    static_assert(!CombatVisitor::canKill(NpcType::Pegasus, NpcType::Knight));
+
+    size_t kills = 0;
+    for (const auto& row : KILL_MATRIX) {
+        for (bool cell : row) kills += cell;
+    }
+    EXPECT_EQ(kills, 2);
+}
+
+TEST(KillMatrixTest, TypeNames) {
+    EXPECT_EQ(npcTypeName(NpcType::Knight), "Knight");
+    EXPECT_EQ(npcTypeName(NpcType::Squirrel), "Squirrel");
+    EXPECT_EQ(npcTypeName(NpcType::Pegasus), "Pegasus");
+
+    NpcType type;
+    EXPECT_TRUE(parseNpcType("Pegasus", type));
+    EXPECT_EQ(type, NpcType::Pegasus);
+    EXPECT_FALSE(parseNpcType("Dragon", type));
+
+    Squirrel squirrel(1, 2, "Nutty");
+    EXPECT_EQ(squirrel.getTypeId(), NpcType::Squirrel);
+}
+
+// тесты асинхронной шины событий
+class SlowObserver : public Observer {
+public:
+    std::vector<uint64_t> events;
+    size_t flushes = 0;
+
+    void notify(const CombatEvent& event) override {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        events.push_back(event.tick);
+    }
+
+    void flush() override {
+        ++flushes;
+    }
+};
+
+static CombatEvent makeEvent(uint64_t tick) {
+    return CombatEvent{CombatEventKind::Kill, NpcType::Knight, NpcType::Squirrel, 0, 0, 0, 0, tick};
+}
+
+TEST(EventBusTest, DeliversInOrderAfterFlush) {
+    for (BackPressure policy : {BackPressure::Block, BackPressure::Grow}) {
+        EventBus bus(EventBus::Config{8, 4, policy});
+        auto observer = std::make_shared<SlowObserver>();
+        bus.setObservers({observer});
+
+        std::vector<uint64_t> expected;
+        for (uint64_t i = 0; i < 500; ++i) {
+            expected.push_back(i);
+            bus.publish(makeEvent(i));
+        }
+        bus.flush();
+
+        EXPECT_EQ(observer->events, expected);
+        EXPECT_GT(observer->flushes, 0u);
+        EXPECT_EQ(bus.dropped(), 0u);
+    }
+}
+
+TEST(EventBusTest, DropPolicyCountsLostEvents) {
+    EventBus bus(EventBus::Config{4, 1, BackPressure::Drop});
+    auto observer = std::make_shared<SlowObserver>();
+    bus.setObservers({observer});
+
+    for (uint64_t i = 0; i < 200; ++i) {
+        bus.publish(makeEvent(i));
+    }
+    bus.flush();
+
+    EXPECT_EQ(observer->events.size() + bus.dropped(), 200u);
+    EXPECT_TRUE(std::is_sorted(observer->events.begin(), observer->events.end()));
+}
+
+TEST(EventBusTest, ArenaAsyncMatchesSync) {
+    auto world = makeRandomWorld(3000, 300, 11);
+
+    auto run = [&](bool async) {
+        Arena arena(300, 300);
+        auto observer = std::make_shared<RecordingObserver>();
+        arena.addObserver(observer);
+        if (async) arena.enableAsyncEvents();
+        for (const auto& spec : world) {
+            arena.createAndAddNpc(spec.type, spec.name, spec.x, spec.y);
+        }
+        arena.startBattle(6.0);
+        arena.flushEvents();
+        return observer->events;
+    };
+
+    auto sync = run(false);
+    EXPECT_FALSE(sync.empty());
+    EXPECT_EQ(run(true), sync);
+}
+
+// тесты структурированных событий
+class CountingObserver : public Observer {
+public:
+    std::vector<CombatEvent> events;
+
+    void notify(const CombatEvent& event) override {
+        events.push_back(event);
+    }
+};
+
+TEST(CombatEventTest, StructuredAndTextObserversSeeSameBattle) {
+    Arena arena;
+    auto structured = std::make_shared<CountingObserver>();
+    auto text = std::make_shared<RecordingObserver>();
+    arena.addObserver(structured);
+    arena.addObserver(text);
+
+    arena.createAndAddNpc("Knight", "Knight1", 100, 100);
+    arena.createAndAddNpc("Squirrel", "Squirrel1", 110, 110);
+    arena.startBattle(50.0);
+
+    ASSERT_EQ(structured->events.size(), 1u);
+    const CombatEvent& event = structured->events[0];
+    EXPECT_EQ(event.kind, CombatEventKind::Kill);
+    EXPECT_EQ(event.attackerType, NpcType::Knight);
+    EXPECT_EQ(event.defenderType, NpcType::Squirrel);
+    EXPECT_EQ(StringInterner::global().view(event.attackerId), "Knight1");
+    EXPECT_EQ(StringInterner::global().view(event.defenderId), "Squirrel1");
+    EXPECT_EQ(event.x, 110);
+    EXPECT_EQ(event.y, 110);
+
+    ASSERT_EQ(text->events.size(), 1u);
+    EXPECT_EQ(text->events[0], "Knight1 (Knight) killed Squirrel1 (Squirrel)");
+}
+
+TEST(CombatEventTest, MutualKillFormat) {
+    CombatEvent event{CombatEventKind::MutualKill, NpcType::Knight, NpcType::Pegasus,
+                      StringInterner::global().intern("A"), StringInterner::global().intern("B"),
+                      0, 0, 7};
+    EXPECT_EQ(formatEvent(event), "A (Knight) and B (Pegasus) killed each other");
+    static_assert(std::is_trivially_copyable_v<CombatEvent>);
+}
+
+// тесты буферизованного файлового наблюдателя
+static std::vector<std::string> readLines(const std::string& filename) {
+    std::ifstream file(filename);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line)) lines.push_back(line);
+    return lines;
+}
+
+TEST(FileObserverTest, BuffersUntilFlush) {
+    const std::string logfile = "test_buffered_log.txt";
+    std::remove(logfile.c_str());
+
+    FileObserver::Options options;
+    options.flushOnBatch = false;
+    {
+        FileObserver observer(logfile, options);
+        observer.notify(std::string("first"));
+        observer.notify(std::string("second"));
+
+        // пока буфер не сброшен, файл пуст
+        EXPECT_TRUE(readLines(logfile).empty());
+        observer.flush();
+        EXPECT_TRUE(readLines(logfile).empty());
+    }
+
+    // деструктор сбрасывает остаток
+    EXPECT_EQ(readLines(logfile), (std::vector<std::string>{"first", "second"}));
+    std::remove(logfile.c_str());
+}
+
+TEST(FileObserverTest, FlushBySizeAndBatch) {
+    const std::string logfile = "test_size_log.txt";
+    std::remove(logfile.c_str());
+
+    FileObserver::Options options;
+    options.bufferSize = 16;
+    options.flushOnBatch = false;
+    FileObserver observer(logfile, options);
+    observer.notify(std::string("0123456789"));
+    EXPECT_TRUE(readLines(logfile).empty());
+    observer.notify(std::string("abcdefghij"));
+    EXPECT_EQ(readLines(logfile).size(), 2u);
+
+    std::remove(logfile.c_str());
+}
+
+TEST(FileObserverTest, RotatesBySize) {
+    const std::string logfile = "test_rotate_log.txt";
+    for (const char* suffix : {"", ".1", ".2", ".3"}) {
+        std::remove((logfile + suffix).c_str());
+    }
+
+    FileObserver::Options options;
+    options.maxFileSize = 32;
+    options.maxFiles = 2;
+    options.syncOnFlush = true;
+    {
+        FileObserver observer(logfile, options);
+        for (int i = 0; i < 10; ++i) {
+            observer.notify("line number " + std::to_string(i));
+            observer.flush();
+        }
+    }
+
+    auto current = readLines(logfile);
+    auto first = readLines(logfile + ".1");
+    auto second = readLines(logfile + ".2");
+    EXPECT_FALSE(current.empty());
+    EXPECT_FALSE(first.empty());
+    EXPECT_FALSE(second.empty());
+    EXPECT_TRUE(readLines(logfile + ".3").empty());
+    EXPECT_EQ(current.back(), "line number 9");
+
+    for (const char* suffix : {"", ".1", ".2"}) {
+        std::remove((logfile + suffix).c_str());
+    }
+}
+
+TEST(FileObserverTest, MissingDirectoryIsNotFatal) {
+    // как и до буферизации: файл не открылся - события не пишутся, исключений нет
+    const std::string logfile = "no_such_dir/test_log.txt";
+    EXPECT_NO_THROW({
+        FileObserver observer(logfile);
+        observer.notify(std::string("lost"));
+        observer.flush();
+    });
+    EXPECT_TRUE(readLines(logfile).empty());
+}
+
+// тесты двоичных снимков
+TEST(SnapshotTest, BinaryRoundtripMatchesText) {
+    const std::string textFile = "test_snapshot.txt";
+    const std::string binaryFile = "test_snapshot.bin";
+
+    Arena arena(500, 500);
+    arena.loadFromFile("test_data_npcs.txt");
+    arena.saveToFile(textFile);
+    arena.saveToFile(binaryFile, SnapshotFormat::Binary);
+    EXPECT_EQ(detectSnapshotFormat(textFile), SnapshotFormat::Text);
+    EXPECT_EQ(detectSnapshotFormat(binaryFile), SnapshotFormat::Binary);
+
+    // формат определяется по сигнатуре
+    Arena loaded(500, 500);
+    loaded.loadFromFile(binaryFile);
+    EXPECT_EQ(loaded.getNpcCount(), arena.getNpcCount());
+    loaded.saveToFile("test_snapshot_reloaded.txt");
+
+    std::ifstream expected(textFile), actual("test_snapshot_reloaded.txt");
+    std::string a((std::istreambuf_iterator<char>(expected)), std::istreambuf_iterator<char>());
+    std::string b((std::istreambuf_iterator<char>(actual)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(a, b);
+
+    std::remove(textFile.c_str());
+    std::remove(binaryFile.c_str());
+    std::remove("test_snapshot_reloaded.txt");
+}
+
+TEST(SnapshotTest, ConvertBetweenFormats) {
+    convertSnapshot("test_data_npcs.txt", "test_convert.bin", SnapshotFormat::Binary);
+    convertSnapshot("test_convert.bin", "test_convert.txt", SnapshotFormat::Auto);
+
+    Arena original(500, 500);
+    original.loadFromFile("test_data_npcs.txt");
+    Arena converted(500, 500);
+    converted.loadFromFile("test_convert.txt", SnapshotFormat::Text);
+    EXPECT_EQ(savedNames(converted), savedNames(original));
+
+    std::remove("test_convert.bin");
+    std::remove("test_convert.txt");
+}
+
+TEST(SnapshotTest, CorruptedSnapshotRejected) {
+    const std::string binaryFile = "test_corrupted.bin";
+    Arena arena(100, 100);
+    arena.createAndAddNpc("Knight", "Arthur", 10, 10);
+    arena.createAndAddNpc("Squirrel", "Chip", 20, 20);
+    arena.saveToFile(binaryFile, SnapshotFormat::Binary);
+
+    // порча одного байта ловится контрольной суммой
+    {
+        std::fstream file(binaryFile, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(sizeof(SnapshotHeader) + 10);
+        file.put('#');
+    }
+    Arena loaded(100, 100);
+    EXPECT_THROW(loaded.loadFromFile(binaryFile), std::runtime_error);
+    EXPECT_EQ(loaded.getNpcCount(), 0);
+
+    std::remove(binaryFile.c_str());
+}
+
+// тесты быстрого разбора строк
+TEST(NpcParserTest, MatchesStreamParsing) {
+    const std::vector<std::string> lines = {
+        "Knight Arthur 10 20", "  Squirrel\tChip   +5 -0 ", "Pegasus Wind 7 8 extra",
+        "Knight Lance 10abc 20", "Knight Lance 10 20abc", "Knight Lance", "Knight Lance +-1 2",
+        "Knight Lance 99999999999 1", "Knight Lance - 1", "Knight Lance 1 2\r", "   ",
+        "Dragon Smaug 1 1", "Knight Lance 1", "Squirrel Nut 0x10 5",
+    };
+
+    for (const auto& line : lines) {
+        // ожидаемое поведение - разбор через поток, как было раньше
+        std::istringstream iss(line);
+        std::string type, name;
+        int x = 0, y = 0;
+        iss >> type >> name >> x >> y;
+
+        if (iss.fail()) {
+            try {
+                parseNpcLine(line);
+                ADD_FAILURE() << "no error for: " << line;
+            } catch (const std::runtime_error& e) {
+                EXPECT_EQ(std::string(e.what()), "Failed to read line: " + line);
+            }
+            continue;
+        }
+        NpcType expectedType;
+        if (!parseNpcType(type, expectedType)) {
+            try {
+                parseNpcLine(line);
+                ADD_FAILURE() << "no error for: " << line;
+            } catch (const std::invalid_argument& e) {
+                EXPECT_EQ(std::string(e.what()), "Unknown NPC type: " + type);
+            }
+            continue;
+        }
+        ParsedNpc npc = parseNpcLine(line);
+        EXPECT_EQ(npc.type, expectedType) << line;
+        EXPECT_EQ(npc.name, name) << line;
+        EXPECT_EQ(npc.x, x) << line;
+        EXPECT_EQ(npc.y, y) << line;
+    }
+}
+
+TEST(NpcParserTest, TypeHashRejectsNearMisses) {
+    NpcType type;
+    for (size_t i = 0; i < NPC_TYPE_COUNT; ++i) {
+        std::string name(npcTypeName(static_cast<NpcType>(i)));
+        ASSERT_TRUE(parseNpcType(name, type));
+        EXPECT_EQ(type, static_cast<NpcType>(i));
+        EXPECT_FALSE(parseNpcType(name + "s", type));
+        EXPECT_FALSE(parseNpcType(name.substr(1), type));
+    }
+    EXPECT_FALSE(parseNpcType("", type));
+    EXPECT_FALSE(parseNpcType("knight", type));
+}
+
+TEST(NpcParserTest, LoadStopsAtFirstBadLine) {
+    const std::string filename = "test_bad_line.txt";
+    {
+        std::ofstream file(filename);
+        file << "Knight Arthur 10 20\n\nSquirrel Chip 30 40\nKnight Broken\nPegasus Late 1 1\n";
+    }
+
+    Arena arena(100, 100);
+    try {
+        arena.loadFromFile(filename);
+        FAIL() << "expected error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_EQ(std::string(e.what()), "Failed to read line: Knight Broken");
+    }
+    // строки до ошибочной уже добавлены, как при построчной загрузке
+    EXPECT_EQ(arena.getNpcCount(), 2);
+
+    std::remove(filename.c_str());
+}
+
+// тесты параллельной загрузки
+static void writeWorldFile(const std::string& filename, const std::vector<NpcSpec>& world) {
+    std::ofstream file(filename);
+    for (const auto& npc : world) {
+        file << npc.type << " " << npc.name << " " << npc.x << " " << npc.y << "\n";
+    }
+}
+
+// загрузка двумя способами: исключение (тип и текст) и число добавленных NPC
+static std::pair<std::string, size_t> loadOutcome(const std::string& filename, ExecutionPolicy policy) {
+    Arena arena(500, 500);
+    arena.setThreadCount(4);
+    std::string error = "none";
+    try {
+        arena.loadFromFile(filename, SnapshotFormat::Text, policy);
+    } catch (const std::invalid_argument& e) {
+        error = std::string("invalid_argument: ") + e.what();
+    } catch (const std::out_of_range& e) {
+        error = std::string("out_of_range: ") + e.what();
+    } catch (const std::runtime_error& e) {
+        error = std::string("runtime_error: ") + e.what();
+    }
+    return {error, arena.getNpcCount()};
+}
+
+TEST(ParallelLoadTest, MatchesSequential) {
+    const std::string filename = "test_parallel_load.txt";
+    auto world = makeRandomWorld(20000, 500, 11);
+    writeWorldFile(filename, world);
+
+    Arena sequential(500, 500);
+    sequential.loadFromFile(filename);
+    Arena parallel(500, 500);
+    parallel.setThreadCount(4);
+    parallel.loadFromFile(filename, SnapshotFormat::Text, ExecutionPolicy::Parallel);
+
+    EXPECT_EQ(parallel.getNpcCount(), world.size());
+    EXPECT_EQ(savedNames(parallel), savedNames(sequential));
+
+    std::remove(filename.c_str());
+}
+
+TEST(ParallelLoadTest, SameErrorsAsSequential) {
+    const std::string filename = "test_parallel_errors.txt";
+    auto world = makeRandomWorld(20000, 500, 12);
+
+    // повтор имени далеко от оригинала, ошибка формата и выход за границы позже
+    auto duplicate = world;
+    duplicate[15000].name = duplicate[10].name;
+    duplicate[18000].type = "Dragon";
+    auto broken = world;
+    broken[12000].name = "";
+    broken[16000].name = duplicate[3].name;
+    auto outside = world;
+    outside[9000].x = 900;
+
+    for (const auto& variant : {duplicate, broken, outside}) {
+        writeWorldFile(filename, variant);
+        auto expected = loadOutcome(filename, ExecutionPolicy::Sequential);
+        EXPECT_NE(expected.first, "none");
+        EXPECT_EQ(loadOutcome(filename, ExecutionPolicy::Parallel), expected);
+    }
+
+    std::remove(filename.c_str());
+}
+
+// тесты пула NPC
+TEST(NpcPoolTest, ReusesFreedCells) {
+    NpcPool pool;
+    auto knight = NpcFactory::createNpc(pool, "Knight", "Arthur", 10, 20);
+    EXPECT_EQ(knight->getType(), "Knight");
+    EXPECT_EQ(knight->getName(), "Arthur");
+    EXPECT_EQ(pool.live(), 1u);
+
+    Npc* address = knight.get();
+    knight.reset();
+    EXPECT_EQ(pool.live(), 0u);
+
+    // ячейка того же типа берётся из списка свободных
+    auto again = NpcFactory::createNpc(pool, "Knight", "Lancelot", 1, 2);
+    EXPECT_EQ(again.get(), address);
+
+    auto squirrel = NpcFactory::createNpc(pool, "Squirrel", "Chip", 3, 4);
+    EXPECT_NE(static_cast<Npc*>(squirrel.get()), address);
+    EXPECT_EQ(squirrel->getTypeId(), NpcType::Squirrel);
+    EXPECT_THROW(NpcFactory::createNpc(pool, "Dragon", "Smaug", 0, 0), std::invalid_argument);
+    EXPECT_EQ(pool.live(), 2u);
+}
+
+TEST(NpcPoolTest, ClearRefusesWithLiveObjects) {
+    NpcPool pool;
+    auto knight = NpcFactory::createNpc(pool, "Knight", "Held", 1, 1);
+    const size_t capacity = pool.capacity();
+    EXPECT_THROW(pool.clear(), std::logic_error);
+    // блоки на месте, объект цел и возвращается в пул как обычно
+    EXPECT_EQ(pool.capacity(), capacity);
+    EXPECT_EQ(knight->getName(), "Held");
+    knight.reset();
+    EXPECT_EQ(pool.live(), 0u);
+    pool.clear();
+    EXPECT_EQ(pool.capacity(), 0u);
+}
+
+TEST(NpcPoolTest, ArenaAcceptsPooledNpcs) {
+    Arena arena(100, 100);
+    for (int i = 0; i < 1000; ++i) {
+        arena.addNpc(NpcFactory::createNpc(arena.npcPool(), i % 2 ? "Knight" : "Pegasus",
+                                           "pooled" + std::to_string(i), i % 100, i % 50));
+    }
+    EXPECT_EQ(arena.getNpcCount(), 1000u);
+    // объекты отдаются обратно сразу после добавления, блоков хватает на один проход
+    EXPECT_EQ(arena.npcPool().live(), 0u);
+    EXPECT_LE(arena.npcPool().capacity(), 2 * 256u);
+
+    arena.clear();
+    EXPECT_EQ(arena.getNpcCount(), 0u);
+    EXPECT_EQ(arena.npcPool().capacity(), 0u);
+}
+
+// тесты инкрементального боя
+TEST(IncrementalBattleTest, MatchesFullRecompute) {
+    auto world = makeRandomWorld(3000, 200, 21);
+    auto incrementalLog = std::make_shared<RecordingObserver>();
+    auto fullLog = std::make_shared<RecordingObserver>();
+    Arena incremental(200, 200), full(200, 200);
+    incremental.addObserver(incrementalLog);
+    full.addObserver(fullLog);
+    for (const auto& npc : world) {
+        incremental.createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+        full.createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+    }
+
+    BattleOptions options;
+    options.incremental = true;
+    options.verify = true;
+
+    // дальность то растёт, то падает: при росте бой идёт полным перебором
+    const double ranges[] = {3.0, 3.0, 2.0, 5.0, 5.0, 1.5, 4.0, 4.0};
+    unsigned state = 7;
+    auto next = [&state]() {
+        state = state * 1103515245u + 12345u;
+        return (state >> 8) & 0xFFFF;
+    };
+    int round = 0;
+    for (double range : ranges) {
+        // несколько новых NPC и перемещения выживших
+        for (int k = 0; k < 20; ++k) {
+            const std::string name = "late" + std::to_string(round) + "_" + std::to_string(k);
+            const char* type = k % 3 == 0 ? "Knight" : k % 3 == 1 ? "Squirrel" : "Pegasus";
+            const int x = next() % 201, y = next() % 201;
+            incremental.createAndAddNpc(type, name, x, y);
+            full.createAndAddNpc(type, name, x, y);
+        }
+        for (const auto& name : savedNames(full)) {
+            if (next() % 50 != 0) continue;
+            const int x = next() % 201, y = next() % 201;
+            incremental.moveNpc(name, x, y);
+            full.moveNpc(name, x, y);
+        }
+
+        ASSERT_NO_THROW(incremental.startBattle(range, options)) << "round " << round;
+        full.startBattle(range);
+        EXPECT_EQ(incrementalLog->events, fullLog->events) << "round " << round;
+        EXPECT_EQ(savedNames(incremental), savedNames(full)) << "round " << round;
+        ++round;
+    }
+}
+
+TEST(IncrementalBattleTest, MoveValidation) {
+    Arena arena(100, 100);
+    arena.createAndAddNpc("Knight", "Arthur", 10, 10);
+    EXPECT_THROW(arena.moveNpc("Nobody", 1, 1), std::invalid_argument);
+    EXPECT_THROW(arena.moveNpc("Arthur", 101, 1), std::out_of_range);
+
+    // после боя без изменений бой на той же дальности ничего не находит,
+    // сдвинутый рыцарь снова может найти белку
+    arena.createAndAddNpc("Squirrel", "Chip", 50, 50);
+    BattleOptions options;
+    options.incremental = true;
+    options.verify = true;
+    arena.startBattle(5.0, options);
+    EXPECT_EQ(arena.getNpcCount(), 2);
+    arena.moveNpc("Arthur", 52, 50);
+    arena.startBattle(5.0, options);
+    EXPECT_EQ(arena.getNpcCount(), 1);
+}
+
+// тесты симуляции с перемещением
+TEST(SimulationTest, NoMovementMatchesBattle) {
+    auto world = makeRandomWorld(2000, 200, 31);
+    auto simulatedLog = std::make_shared<RecordingObserver>();
+    auto battleLog = std::make_shared<RecordingObserver>();
+    Arena simulated(200, 200), battle(200, 200);
+    simulated.addObserver(simulatedLog);
+    battle.addObserver(battleLog);
+    for (const auto& npc : world) {
+        simulated.createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+        battle.createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+    }
+
+    MovePolicy still;
+    still.maxStep = 0;
+    SimulationReport report = simulated.simulate(3, 4.0, still);
+    for (int i = 0; i < 3; ++i) battle.startBattle(4.0);
+
+    ASSERT_EQ(report.ticks.size(), 3u);
+    EXPECT_EQ(report.ticks[2].alive, battle.getNpcCount());
+    // без движения все бои случаются в первом ходу
+    EXPECT_GT(report.ticks[0].kills, 0u);
+    EXPECT_EQ(report.ticks[1].kills + report.ticks[2].kills, 0u);
+    EXPECT_EQ(simulatedLog->events, battleLog->events);
+    EXPECT_EQ(savedNames(simulated), savedNames(battle));
+}
+
+TEST(SimulationTest, LiveGridStaysConsistent) {
+    auto world = makeRandomWorld(5000, 300, 32);
+    auto simulate = [&](ExecutionPolicy policy) {
+        auto observer = std::make_shared<RecordingObserver>();
+        Arena arena(300, 300);
+        arena.setThreadCount(4);
+        arena.addObserver(observer);
+        for (const auto& npc : world) {
+            arena.createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+        }
+        MovePolicy walk;
+        walk.maxStep = 3;
+        walk.seed = 42;
+        SimulationReport report = arena.simulate(50, 2.0, walk, policy);
+        EXPECT_EQ(report.ticks.size(), 50u);
+        EXPECT_EQ(report.ticks.back().alive, arena.getNpcCount());
+        for (size_t t = 1; t < report.ticks.size(); ++t) {
+            EXPECT_LE(report.ticks[t].alive, report.ticks[t - 1].alive);
+        }
+
+        // если сетка разошлась с хранилищем, полный бой найдёт пропущенные пары
+        BattleOptions options;
+        options.incremental = true;
+        options.verify = true;
+        const size_t survivors = arena.getNpcCount();
+        EXPECT_NO_THROW(arena.startBattle(2.0, options));
+        arena.startBattle(2.0);
+        EXPECT_EQ(arena.getNpcCount(), survivors);
+        return std::make_pair(observer->events, savedNames(arena));
+    };
+
+    auto sequential = simulate(ExecutionPolicy::Sequential);
+    EXPECT_FALSE(sequential.first.empty());
+    EXPECT_EQ(simulate(ExecutionPolicy::Parallel), sequential);
+}
+
+TEST(SimulationTest, NegativeRangeMovesWithoutFights) {
+    auto world = makeRandomWorld(1000, 100, 33);
+    auto observer = std::make_shared<RecordingObserver>();
+    Arena moving(100, 100), reference(100, 100);
+    moving.addObserver(observer);
+    for (const auto& npc : world) {
+        moving.createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+        reference.createAndAddNpc(npc.type, npc.name, npc.x, npc.y);
+    }
+
+    // время идёт, как и в startBattle с такой дальностью: NPC ходят, но не дерутся
+    MovePolicy walk;
+    walk.maxStep = 2;
+    for (double range : {-1.0, std::numeric_limits<double>::quiet_NaN()}) {
+        SimulationReport report = moving.simulate(4, range, walk);
+        ASSERT_EQ(report.ticks.size(), 4u);
+        for (const TickStats& tick : report.ticks) {
+            EXPECT_EQ(tick.kills, 0u);
+            EXPECT_EQ(tick.alive, world.size());
+        }
+    }
+    EXPECT_TRUE(observer->events.empty());
+    EXPECT_EQ(moving.getNpcCount(), world.size());
+
+    auto positions = [](const Arena& arena) {
+        std::set<std::tuple<std::string, int, int>> result;
+        for (const auto& npc : arena.queryRect(0, 0, 100, 100)) result.emplace(npc.name, npc.x, npc.y);
+        return result;
+    };
+    EXPECT_EQ(positions(moving).size(), world.size());
+    EXPECT_NE(positions(moving), positions(reference));
+}
+
+TEST(SimulationTest, ValidatesMaxStep) {
+    Arena arena(100, 100);
+    for (int i = 0; i < 200; ++i) {
+        arena.createAndAddNpc("Knight", "walker" + std::to_string(i), i % 101, (i * 7) % 101);
+    }
+
+    MovePolicy backwards;
+    backwards.maxStep = -3;
+    EXPECT_THROW(arena.simulate(1, 0.0, backwards), std::invalid_argument);
+
+    // огромный шаг урезается до размера арены: блуждание в обе стороны, без переполнения
+    MovePolicy huge;
+    huge.maxStep = std::numeric_limits<int>::max();
+    arena.simulate(1, 0.0, huge);
+    std::set<int> xs;
+    for (const auto& npc : arena.queryRect(0, 0, 100, 100)) xs.insert(npc.x);
+    EXPECT_EQ(arena.queryRect(0, 0, 100, 100).size(), 200u);
+    EXPECT_EQ(xs.count(0), 1u);
+    EXPECT_EQ(xs.count(100), 1u);
+    EXPECT_GT(xs.size(), 2u);
+}
+
+// тесты генератора миров
+static std::string fileContents(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+TEST(WorldGeneratorTest, DeterministicUniqueAndInBounds) {
+    WorldSpec spec;
+    spec.count = 5000;
+    spec.width = 300;
+    spec.height = 200;
+    spec.distribution = WorldDistribution::Clustered;
+    spec.clusterRadius = 40;
+    spec.typeWeights = {3.0, 1.0, 0.0};
+    spec.seed = 7;
+
+    WorldGenerator first(spec), second(spec);
+    std::set<std::string> names;
+    size_t knights = 0;
+    GeneratedNpc a, b;
+    while (first.next(a)) {
+        ASSERT_TRUE(second.next(b));
+        EXPECT_EQ(a.type, b.type);
+        EXPECT_EQ(a.name, b.name);
+        EXPECT_EQ(a.x, b.x);
+        EXPECT_EQ(a.y, b.y);
+        EXPECT_NE(a.type, NpcType::Pegasus);
+        EXPECT_TRUE(a.x >= 0 && a.x <= spec.width && a.y >= 0 && a.y <= spec.height);
+        names.insert(std::string(a.name));
+        knights += a.type == NpcType::Knight;
+    }
+    EXPECT_FALSE(second.next(b));
+    EXPECT_EQ(names.size(), spec.count);
+    // доля рыцарей около 3/4
+    EXPECT_NEAR(static_cast<double>(knights) / spec.count, 0.75, 0.03);
+
+    // после reset тот же мир, другое зерно - другой
+    first.reset();
+    ASSERT_TRUE(first.next(a));
+    spec.seed = 8;
+    WorldGenerator other(spec);
+    ASSERT_TRUE(other.next(b));
+    EXPECT_EQ(a.name, "npc0");
+    EXPECT_TRUE(a.x != b.x || a.y != b.y || a.type != b.type);
+
+    spec.typeWeights = {0.0, 0.0, 0.0};
+    EXPECT_THROW(WorldGenerator bad(spec), std::invalid_argument);
+}
+
+TEST(WorldGeneratorTest, HugeClusterRadius) {
+    WorldSpec spec;
+    spec.count = 2000;
+    spec.width = 1000;
+    spec.height = 1000;
+    spec.distribution = WorldDistribution::Clustered;
+    spec.clusterRadius = std::numeric_limits<int>::max();
+
+    // радиус урезается до стороны мира: тот же мир, что и с радиусом 1000
+    WorldGenerator huge(spec);
+    spec.clusterRadius = 1000;
+    WorldGenerator side(spec);
+    GeneratedNpc a, b;
+    while (huge.next(a)) {
+        ASSERT_TRUE(side.next(b));
+        EXPECT_TRUE(a.x >= 0 && a.x <= spec.width && a.y >= 0 && a.y <= spec.height);
+        EXPECT_EQ(a.x, b.x);
+        EXPECT_EQ(a.y, b.y);
+    }
+
+    // границы скопления выходят за int и на очень большой карте
+    spec.width = std::numeric_limits<int>::max();
+    spec.clusterRadius = std::numeric_limits<int>::max();
+    WorldGenerator wide(spec);
+    while (wide.next(a)) {
+        EXPECT_TRUE(a.x >= 0 && a.y >= 0 && a.y <= spec.height);
+    }
+}
+
+TEST(WorldGeneratorTest, AllInRangeIsWorstCase) {
+    WorldSpec spec;
+    spec.count = 300;
+    spec.distribution = WorldDistribution::AllInRange;
+    spec.range = 15.0;
+
+    WorldGenerator generator(spec);
+    std::vector<std::pair<int, int>> points;
+    GeneratedNpc npc;
+    while (generator.next(npc)) points.emplace_back(npc.x, npc.y);
+    for (size_t i = 0; i < points.size(); ++i) {
+        for (size_t j = i + 1; j < points.size(); ++j) {
+            const double dx = points[i].first - points[j].first;
+            const double dy = points[i].second - points[j].second;
+            EXPECT_LE(std::sqrt(dx * dx + dy * dy), spec.range);
+        }
+    }
+}
+
+TEST(WorldGeneratorTest, FilesMatchArena) {
+    WorldSpec spec;
+    spec.count = 20000;
+    spec.distribution = WorldDistribution::Clustered;
+    spec.seed = 3;
+
+    Arena direct(500, 500);
+    generateWorld(spec, direct);
+    EXPECT_EQ(direct.getNpcCount(), spec.count);
+    direct.saveToFile("test_world_direct.txt");
+    direct.saveToFile("test_world_direct.bin", SnapshotFormat::Binary);
+
+    // файлы генератора (в порядке генерации) после загрузки дают ту же арену
+    generateWorldFile(spec, "test_world.txt");
+    generateWorldFile(spec, "test_world.bin", SnapshotFormat::Binary);
+    for (const char* file : {"test_world.txt", "test_world.bin"}) {
+        Arena loaded(500, 500);
+        loaded.loadFromFile(file);
+        loaded.saveToFile("test_world_loaded.txt");
+        loaded.saveToFile("test_world_loaded.bin", SnapshotFormat::Binary);
+        EXPECT_TRUE(fileContents("test_world_loaded.txt") == fileContents("test_world_direct.txt")) << file;
+        EXPECT_TRUE(fileContents("test_world_loaded.bin") == fileContents("test_world_direct.bin")) << file;
+    }
+
+    for (const char* file : {"test_world_direct.txt", "test_world_direct.bin", "test_world.txt",
+                             "test_world.bin", "test_world_loaded.txt", "test_world_loaded.bin"}) {
+        std::remove(file);
+    }
+}
+
+// тесты статистики арены
+TEST(ArenaStatsTest, PrometheusFormat) {
+    ArenaStats stats;
+    stats.battles = 2;
+    stats.kills = 3;
+    stats.scanMs = 250.0;
+    std::ostringstream out;
+    writePrometheusStats(stats, out);
+    const std::string text = out.str();
+    EXPECT_NE(text.find("# TYPE arena_kills_total counter\narena_kills_total 3\n"), std::string::npos);
+    EXPECT_NE(text.find("arena_battles_total 2\n"), std::string::npos);
+    EXPECT_NE(text.find("arena_phase_seconds_total{phase=\"scan\"} 0.25\n"), std::string::npos);
+
+    Arena arena(10, 10);
+    arena.dumpStats("test_arena_stats.prom");
+    const std::string dumped = fileContents("test_arena_stats.prom");
+    EXPECT_NE(dumped.find("arena_pairs_examined_total"), std::string::npos);
+    EXPECT_FALSE(std::ifstream("test_arena_stats.prom.tmp").good());
+    std::remove("test_arena_stats.prom");
+}
+
+TEST(ArenaStatsTest, CountsBattleWork) {
+    const auto world = makeRandomWorld(3000, 200, 11);
+    writeWorldFile("test_stats_world.txt", world);
+
+    auto battle = [](ExecutionPolicy policy) {
+        Arena arena(200, 200);
+        arena.setThreadCount(4);
+        auto observer = std::make_shared<RecordingObserver>();
+        arena.addObserver(observer);
+        arena.loadFromFile("test_stats_world.txt", SnapshotFormat::Text, policy);
+        const size_t before = arena.getNpcCount();
+        arena.startBattle(5.0, policy);
+        ArenaStats stats = arena.getStats();
+
+        if (!ARENA_STATS_ENABLED) {
+            EXPECT_EQ(stats.battles, 0u);
+            EXPECT_EQ(stats.pairsExamined, 0u);
+            return stats;
+        }
+        EXPECT_EQ(stats.battles, 1u);
+        EXPECT_EQ(stats.loads, 1u);
+        EXPECT_EQ(stats.npcsLoaded, 3000u);
+        EXPECT_GT(stats.bytesLoaded, 0u);
+        EXPECT_EQ(stats.kills, observer->events.size());
+        EXPECT_EQ(stats.eventsDispatched, observer->events.size());
+        EXPECT_EQ(stats.removed, before - arena.getNpcCount());
+        EXPECT_GE(stats.pairsExamined, stats.pairsInRange);
+        EXPECT_GE(stats.pairsInRange, stats.kills);
+        EXPECT_GE(stats.battleMs, stats.scanMs);
+
+        arena.resetStats();
+        EXPECT_EQ(arena.getStats().battles, 0u);
+        return stats;
+    };
+
+    // потоки пула пишут в свои счётчики, итог тот же, что и без пула
+    const ArenaStats sequential = battle(ExecutionPolicy::Sequential);
+    const ArenaStats parallel = battle(ExecutionPolicy::Parallel);
+    EXPECT_EQ(parallel.pairsExamined, sequential.pairsExamined);
+    EXPECT_EQ(parallel.pairsInRange, sequential.pairsInRange);
+    EXPECT_EQ(parallel.kills, sequential.kills);
+    std::remove("test_stats_world.txt");
+}
+
+// тесты боя на больших картах с делением на плитки
+static std::vector<NpcSpec> makeBorderWorld(size_t count, int tileSide, unsigned seed) {
+    // NPC скучены у границ и углов плиток, чтобы пары через границу встречались часто
+    const char* types[] = {"Knight", "Squirrel", "Pegasus"};
+    std::vector<NpcSpec> world;
+    unsigned state = seed;
+    auto next = [&state]() {
+        state = state * 1103515245u + 12345u;
+        return (state >> 8) & 0xFFFF;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        const int x = static_cast<int>(1 + next() % 6) * tileSide + static_cast<int>(next() % 17) - 8;
+        const int y = static_cast<int>(1 + next() % 3) * tileSide + static_cast<int>(next() % 17) - 8;
+        world.push_back({types[next() % 3], "npc" + std::to_string(i), x, y});
+    }
+    return world;
+}
+
+TEST(ShardedBattleTest, MatchesBruteForceAcrossTiles) {
+    const double range = 5.0;
+    const int size = 100000;
+    ASSERT_TRUE(ShardedGrid::needed(size, size, range));
+    ASSERT_FALSE(ShardedGrid::needed(DEFAULT_WIDTH, DEFAULT_HEIGHT, 1.0));
+
+    const auto world = makeBorderWorld(3000, ShardedGrid::TILE_CELLS * 5, 21);
+    std::vector<std::string> survivors;
+    const auto expected = bruteForceBattle(world, range, survivors);
+    ASSERT_FALSE(expected.empty());
+
+    for (ExecutionPolicy policy : {ExecutionPolicy::Sequential, ExecutionPolicy::Parallel}) {
+        Arena arena(size, size);
+        arena.setThreadCount(4);
+        auto observer = std::make_shared<RecordingObserver>();
+        arena.addObserver(observer);
+        for (const auto& spec : world) {
+            arena.createAndAddNpc(spec.type, spec.name, spec.x, spec.y);
+        }
+        arena.startBattle(range, policy);
+        // каждая пара через границу плиток дала ровно одно событие
+        EXPECT_EQ(observer->events, expected);
+        EXPECT_EQ(savedNames(arena), survivors);
+    }
+}
+
+TEST(ShardedBattleTest, MaxSizeWorld) {
+    Arena arena(MAX_WIDTH, MAX_HEIGHT);
+    arena.createAndAddNpc("Knight", "Arthur", MAX_WIDTH, MAX_HEIGHT);
+    arena.createAndAddNpc("Squirrel", "Chip", MAX_WIDTH - 3, MAX_HEIGHT - 4);
+    arena.createAndAddNpc("Squirrel", "Dale", 0, 0);
+    arena.createAndAddNpc("Pegasus", "Sky", 1, 1);
+    EXPECT_THROW(arena.createAndAddNpc("Knight", "Far", MAX_WIDTH + 1, 0), std::out_of_range);
+
+    // инкрементальный режим на такой карте сводится к полному перебору
+    BattleOptions options;
+    options.incremental = true;
+    options.verify = true;
+    arena.startBattle(5.0, options);
+    EXPECT_EQ(savedNames(arena), (std::vector<std::string>{"Arthur", "Dale"}));
+
+    MovePolicy still;
+    still.maxStep = 0;
+    SimulationReport report = arena.simulate(2, 5.0, still);
+    EXPECT_EQ(report.ticks.size(), 2u);
+    EXPECT_EQ(arena.getNpcCount(), 2);
+}
+
+// тесты боя над файлом
+static std::vector<std::string> sortedLines(const std::string& filename) {
+    std::ifstream file(filename);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+TEST(StreamingBattleTest, MatchesInMemoryBattle) {
+    const std::string input = "test_stream_input.txt";
+    const std::string output = "test_stream_output.txt";
+    const std::string expectedFile = "test_stream_expected.txt";
+    writeWorldFile(input, makeRandomWorld(20000, 500, 17));
+
+    Arena memory(500, 500);
+    auto expected = std::make_shared<RecordingObserver>();
+    memory.addObserver(expected);
+    memory.loadFromFile(input);
+    memory.startBattle(2.0);
+    memory.saveToFile(expectedFile);
+
+    // маленький бюджет: больше 64 кусков, слияние в два прохода
+    Arena streaming(500, 500);
+    auto observer = std::make_shared<RecordingObserver>();
+    streaming.addObserver(observer);
+    StreamingOptions options;
+    options.memoryBudget = 16 << 10;
+    StreamingReport report = streaming.startStreamingBattle(input, output, 2.0, options);
+
+    EXPECT_EQ(report.npcs, 20000u);
+    EXPECT_GT(report.runs, 64u);
+    EXPECT_EQ(report.survivors, memory.getNpcCount());
+    EXPECT_EQ(report.kills, expected->events.size());
+    EXPECT_EQ(streaming.getNpcCount(), 0);
+    std::sort(expected->events.begin(), expected->events.end());
+    std::sort(observer->events.begin(), observer->events.end());
+    EXPECT_EQ(observer->events, expected->events);
+    EXPECT_EQ(sortedLines(output), sortedLines(expectedFile));
+
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+    std::remove(expectedFile.c_str());
+}
+
+TEST(StreamingBattleTest, ErrorsLeaveNoFiles) {
+    const std::string input = "test_stream_bad.txt";
+    const std::string output = "test_stream_bad_output.txt";
+    const std::string tempDir = "test_stream_tmp";
+    std::filesystem::create_directory(tempDir);
+    StreamingOptions options;
+    options.tempDir = tempDir;
+    options.memoryBudget = 4 << 10;
+
+    Arena arena(100, 100);
+    auto world = makeRandomWorld(2000, 100, 5);
+    world.push_back({"Knight", "Far", 101, 0});
+    writeWorldFile(input, world);
+    EXPECT_THROW(arena.startStreamingBattle(input, output, 1.0, options), std::out_of_range);
+    EXPECT_FALSE(std::filesystem::exists(output));
+    EXPECT_TRUE(std::filesystem::is_empty(tempDir));
+
+    // одна полоса не помещается в бюджет; прежний результат остаётся как был
+    world.pop_back();
+    for (auto& npc : world) npc.y = 50;
+    writeWorldFile(input, world);
+    {
+        std::ofstream previous(output);
+        previous << "Knight Previous 1 1\n";
+    }
+    EXPECT_THROW(arena.startStreamingBattle(input, output, 1.0, options), std::runtime_error);
+    EXPECT_TRUE(std::filesystem::is_empty(tempDir));
+    EXPECT_EQ(sortedLines(output), (std::vector<std::string>{"Knight Previous 1 1"}));
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        EXPECT_EQ(entry.path().filename().string().find(output + ".partial"), std::string::npos);
+    }
+
+    std::filesystem::remove_all(tempDir);
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+}
+
+// тесты запросов по области
+static std::vector<NpcSpec> arenaWorld(const Arena& arena) {
+    const std::string filename = "test_query_world.txt";
+    arena.saveToFile(filename);
+    std::ifstream file(filename);
+    std::vector<NpcSpec> world;
+    NpcSpec spec;
+    while (file >> spec.type >> spec.name >> spec.x >> spec.y) {
+        world.push_back(spec);
+    }
+    file.close();
+    std::remove(filename.c_str());
+    return world;
+}
+
+static std::vector<std::string> infoNames(const std::vector<NpcInfo>& found) {
+    std::vector<std::string> names;
+    for (const auto& npc : found) names.emplace_back(npc.name);
+    return names;
+}
+
+// ответы индекса против перебора всех NPC арены
+static void expectQueriesMatch(const Arena& arena, unsigned seed) {
+    const auto world = arenaWorld(arena);
+    unsigned state = seed;
+    auto next = [&state](unsigned limit) {
+        state = state * 1103515245u + 12345u;
+        return static_cast<int>(((state >> 8) & 0xFFFFFF) % limit);
+    };
+    for (int q = 0; q < 30; ++q) {
+        const int x = next(540) - 20, y = next(540) - 20;
+        const double radius = next(400) / 10.0;
+        std::vector<std::string> inRadius, inRect;
+        std::vector<std::pair<int64_t, std::string>> all, squirrels;
+        const int x1 = x + next(60), y1 = y + next(60);
+        for (const auto& npc : world) {
+            const int64_t dx = npc.x - x, dy = npc.y - y;
+            if (std::sqrt(static_cast<double>(dx * dx + dy * dy)) <= radius) inRadius.push_back(npc.name);
+            if (npc.x >= x && npc.x <= x1 && npc.y >= y && npc.y <= y1) inRect.push_back(npc.name);
+            all.push_back({dx * dx + dy * dy, npc.name});
+            if (npc.type == "Squirrel") squirrels.push_back({dx * dx + dy * dy, npc.name});
+        }
+        std::sort(all.begin(), all.end());
+        std::sort(squirrels.begin(), squirrels.end());
+        const size_t k = static_cast<size_t>(next(20));
+        std::vector<std::string> nearest, nearestSquirrels;
+        for (size_t i = 0; i < std::min(k, all.size()); ++i) nearest.push_back(all[i].second);
+        for (size_t i = 0; i < std::min(k, squirrels.size()); ++i) nearestSquirrels.push_back(squirrels[i].second);
+
+        EXPECT_EQ(infoNames(arena.queryRadius(x, y, radius)), inRadius) << x << " " << y << " " << radius;
+        EXPECT_EQ(infoNames(arena.queryRect(x, y, x1, y1)), inRect);
+        EXPECT_EQ(infoNames(arena.kNearest(x, y, k)), nearest);
+        EXPECT_EQ(infoNames(arena.kNearest(x, y, k, NpcType::Squirrel)), nearestSquirrels);
+    }
+}
+
+TEST(QueryTest, MatchesBruteForceAcrossChanges) {
+    Arena arena(500, 500);
+    for (const auto& spec : makeRandomWorld(3000, 500, 23)) {
+        arena.createAndAddNpc(spec.type, spec.name, spec.x, spec.y);
+    }
+    expectQueriesMatch(arena, 1);
+
+    // индекс уже построен и дальше обновляется на месте
+    arena.moveNpc("npc5", 0, 0);
+    arena.moveNpc("npc6", 250, 250);
+    arena.createAndAddNpc("Squirrel", "late", 251, 250);
+    std::vector<NpcSpawn> wave{{"Squirrel", "wave1", 10, 10}, {"Knight", "wave2", 490, 3}};
+    arena.createAndAddNpcs(wave);
+    expectQueriesMatch(arena, 2);
+
+    arena.startBattle(3.0);
+    expectQueriesMatch(arena, 3);
+
+    MovePolicy move;
+    move.maxStep = 4;
+    arena.simulate(2, 2.0, move);
+    expectQueriesMatch(arena, 4);
+
+    arena.clear();
+    EXPECT_TRUE(arena.kNearest(1, 1, 5).empty());
+    arena.createAndAddNpc("Pegasus", "alone", 499, 499);
+    EXPECT_EQ(infoNames(arena.kNearest(0, 0, 5)), (std::vector<std::string>{"alone"}));
+    EXPECT_TRUE(arena.kNearest(0, 0, 5, NpcType::Knight).empty());
+    EXPECT_TRUE(arena.queryRadius(0, 0, -1.0).empty());
+}
+
+TEST(QueryTest, NearestTiesByName) {
+    Arena arena(100, 100);
+    arena.createAndAddNpc("Knight", "b", 50, 53);
+    arena.createAndAddNpc("Squirrel", "a", 53, 50);
+    arena.createAndAddNpc("Squirrel", "c", 47, 50);
+    arena.createAndAddNpc("Pegasus", "far", 99, 99);
+    auto found = arena.kNearest(50, 50, 3);
+    EXPECT_EQ(infoNames(found), (std::vector<std::string>{"a", "b", "c"}));
+    EXPECT_EQ(found[0].type, NpcType::Squirrel);
+    EXPECT_EQ(found[0].x, 53);
+    EXPECT_EQ(infoNames(arena.kNearest(50, 50, 2, NpcType::Squirrel)), (std::vector<std::string>{"a", "c"}));
+}
+
+// тесты снимков для читателей
+TEST(ArenaSnapshotTest, PublishesImmutableVersions) {
+    Arena arena(100, 100);
+    arena.createAndAddNpc("Knight", "before", 1, 1);
+    EXPECT_EQ(arena.readSnapshot()->version, 0u);
+
+    arena.enableSnapshots();
+    uint64_t version;
+    {
+        auto first = arena.readSnapshot();
+        version = first->version;
+        EXPECT_EQ(first->size(), 1u);
+
+        arena.createAndAddNpc("Squirrel", "prey", 2, 2);
+        arena.createAndAddNpc("Pegasus", "sky", 90, 90);
+        // снимок у читателя не меняется, пока его держат
+        EXPECT_EQ(first->size(), 1u);
+        EXPECT_EQ(first->name(0), "before");
+    }
+
+    arena.startBattle(5.0);
+    auto afterBattle = arena.readSnapshot();
+    EXPECT_EQ(afterBattle->version, version + 3);
+    EXPECT_EQ(afterBattle->tick, 1u);
+    std::ostringstream printed;
+    afterBattle->print(printed);
+    EXPECT_EQ(printed.str(), "NPC [Knight] before @ (1, 1)\nNPC [Pegasus] sky @ (90, 90)\n");
+
+    // неудачный пакет ничего не меняет и не публикуется
+    std::vector<NpcSpawn> bad{{"Knight", "ok", 1, 1}, {"Knight", "far", 500, 1}};
+    EXPECT_THROW(arena.createAndAddNpcs(bad), std::out_of_range);
+    arena.clear();
+    auto empty = arena.readSnapshot();
+    EXPECT_EQ(empty->version, version + 4);
+    EXPECT_EQ(empty->size(), 0u);
+    EXPECT_EQ(afterBattle->size(), 2u);
+}
+
+TEST(ArenaSnapshotTest, RetiredVersionsWaitForReaders) {
+    SnapshotPublisher publisher;
+    auto held = std::make_unique<SnapshotPublisher::ReadGuard>(publisher.read());
+    for (int i = 0; i < 5; ++i) {
+        auto snapshot = publisher.acquire();
+        snapshot->tick = static_cast<uint64_t>(i);
+        publisher.publish(std::move(snapshot));
+    }
+    // первый снимок держит читатель, вместе с ним ждут и все более поздние замены
+    EXPECT_EQ(publisher.retiredCount(), 5u);
+    EXPECT_EQ((*held)->version, 0u);
+    held.reset();
+
+    publisher.publish(publisher.acquire());
+    EXPECT_EQ(publisher.retiredCount(), 0u);
+    EXPECT_EQ(publisher.read()->version, 6u);
+}
+
+TEST(ArenaSnapshotTest, ConsistentUnderConcurrentWrites) {
+    Arena arena(200, 200);
+    arena.enableSnapshots();
+    std::atomic<bool> done{false};
+    std::atomic<size_t> reads{0};
+    std::atomic<size_t> broken{0};
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            uint64_t last = 0;
+            while (!done.load()) {
+                auto snapshot = arena.readSnapshot();
+                // столбцы одной длины, версии не убывают, имена волны - все или никто
+                const size_t n = snapshot->size();
+                std::set<uint32_t> names;
+                size_t rows = 0;
+                snapshot->rows.forEach([&](const SnapshotRows::Row& row) {
+                    names.insert(row.nameId);
+                    ++rows;
+                });
+                bool ok = rows == n && names.size() == n && snapshot->version >= last;
+                ok = ok && n % 50 == 0;
+                if (!ok) ++broken;
+                last = snapshot->version;
+                ++reads;
+            }
+        });
+    }
+
+    for (int wave = 0; wave < 200; ++wave) {
+        std::vector<NpcSpawn> spawns;
+        for (int i = 0; i < 50; ++i) {
+            spawns.push_back({"Knight", "snap" + std::to_string(wave) + "_" + std::to_string(i), (wave * 7 + i) % 200, i});
+        }
+        arena.createAndAddNpcs(spawns);
+        if (wave % 20 == 19) arena.clear();
+    }
+    while (reads.load() < 100) std::this_thread::yield();
+    done = true;
+    for (auto& reader : readers) reader.join();
+
+    EXPECT_EQ(broken.load(), 0u);
+    EXPECT_EQ(arena.readSnapshot()->size(), 0u);
+}
+
+TEST(ArenaSnapshotTest, SingleChangesKeepOlderVersions) {
+    // по одному NPC за вызов: каждая версия делит строки с предыдущими
+    Arena arena(1000, 1000);
+    arena.enableSnapshots();
+    const size_t count = 5000;
+    std::vector<SnapshotPublisher::ReadGuard> held;
+    for (size_t i = 0; i < count; ++i) {
+        arena.createAndAddNpc(i % 3 ? "Knight" : "Squirrel", "row" + std::to_string(i),
+                              static_cast<int>(i % 1000), static_cast<int>(i / 5));
+        if (i % 1000 == 999) held.push_back(arena.readSnapshot());
+    }
+    for (size_t i = 0; i < count; i += 7) {
+        arena.moveNpc("row" + std::to_string(i), 1, 1);
+    }
+    auto last = arena.readSnapshot();
+
+    for (size_t h = 0; h < held.size(); ++h) {
+        const ArenaSnapshot& snapshot = *held[h];
+        ASSERT_EQ(snapshot.size(), (h + 1) * 1000);
+        size_t i = 0;
+        snapshot.rows.forEach([&](const SnapshotRows::Row& row) {
+            EXPECT_EQ(snapshot.name(i), "row" + std::to_string(i));
+            EXPECT_EQ(row.type, i % 3 ? NpcType::Knight : NpcType::Squirrel);
+            EXPECT_EQ(row.x, static_cast<int>(i % 1000));
+            EXPECT_EQ(row.y, static_cast<int>(i / 5));
+            ++i;
+        });
+    }
+    ASSERT_EQ(last->size(), count);
+    for (size_t i = 0; i < count; ++i) {
+        const SnapshotRows::Row& row = last->rows[i];
+        EXPECT_EQ(row.x, i % 7 ? static_cast<int>(i % 1000) : 1);
+        EXPECT_EQ(row.y, i % 7 ? static_cast<int>(i / 5) : 1);
+    }
+
+    std::ostringstream fromSnapshot;
+    last->print(fromSnapshot);
+    testing::internal::CaptureStdout();
+    arena.printAllNpcs();
+    EXPECT_EQ(fromSnapshot.str(), testing::internal::GetCapturedStdout());
+}
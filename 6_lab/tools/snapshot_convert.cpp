@@ -0,0 +1,33 @@
+#include "../include/snapshot.h"
+#include <iostream>
+#include <string>
+
+// перевод файла NPC между текстовым и двоичным форматами:
+//   6_lab_snapshot_convert <вход> <выход> [text|binary]
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 4) {
+        std::cerr << "usage: " << argv[0] << " <input> <output> [text|binary]" << std::endl;
+        return 1;
+    }
+
+    SnapshotFormat format = SnapshotFormat::Auto;
+    if (argc == 4) {
+        const std::string name = argv[3];
+        if (name == "text") {
+            format = SnapshotFormat::Text;
+        } else if (name == "binary") {
+            format = SnapshotFormat::Binary;
+        } else {
+            std::cerr << "unknown format: " << name << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        convertSnapshot(argv[1], argv[2], format);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "../include/world_generator.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// генерация синтетического мира в файл:
+//   6_lab_world_gen <выход> [--count=N] [--width=W] [--height=H]
+//       [--distribution=uniform|clustered|all-in-range] [--clusters=K] [--cluster-radius=R]
+//       [--range=R] [--mix=Knight:1,Squirrel:1,Pegasus:1] [--seed=S] [--prefix=npc]
+//       [--format=text|binary]
+
+static bool parseMix(const std::string& text, WorldSpec& spec) {
+    spec.typeWeights.fill(0.0);
+    std::istringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        const size_t colon = item.find(':');
+        NpcType type;
+        if (colon == std::string::npos || !parseNpcType(std::string_view(item).substr(0, colon), type)) {
+            return false;
+        }
+        spec.typeWeights[npcTypeIndex(type)] = std::atof(item.c_str() + colon + 1);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    const char* usage =
+        " <output> [--count=N] [--width=W] [--height=H]"
+        " [--distribution=uniform|clustered|all-in-range] [--clusters=K] [--cluster-radius=R]"
+        " [--range=R] [--mix=Knight:1,Squirrel:1,Pegasus:1] [--seed=S] [--prefix=npc]"
+        " [--format=text|binary]";
+
+    WorldSpec spec;
+    SnapshotFormat format = SnapshotFormat::Text;
+    std::string output;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&arg](const char* prefix) -> const char* {
+            const size_t length = std::strlen(prefix);
+            return arg.compare(0, length, prefix) == 0 ? arg.c_str() + length : nullptr;
+        };
+        bool ok = true;
+        if (const char* v = value("--count=")) {
+            spec.count = std::strtoull(v, nullptr, 10);
+        } else if (const char* v = value("--width=")) {
+            spec.width = std::atoi(v);
+        } else if (const char* v = value("--height=")) {
+            spec.height = std::atoi(v);
+        } else if (const char* v = value("--distribution=")) {
+            const std::string name = v;
+            if (name == "uniform") {
+                spec.distribution = WorldDistribution::Uniform;
+            } else if (name == "clustered") {
+                spec.distribution = WorldDistribution::Clustered;
+            } else if (name == "all-in-range") {
+                spec.distribution = WorldDistribution::AllInRange;
+            } else {
+                ok = false;
+            }
+        } else if (const char* v = value("--clusters=")) {
+            spec.clusters = std::strtoull(v, nullptr, 10);
+        } else if (const char* v = value("--cluster-radius=")) {
+            spec.clusterRadius = std::atoi(v);
+        } else if (const char* v = value("--range=")) {
+            spec.range = std::atof(v);
+        } else if (const char* v = value("--mix=")) {
+            ok = parseMix(v, spec);
+        } else if (const char* v = value("--seed=")) {
+            spec.seed = std::strtoull(v, nullptr, 10);
+        } else if (const char* v = value("--prefix=")) {
+            spec.namePrefix = v;
+        } else if (const char* v = value("--format=")) {
+            const std::string name = v;
+            if (name == "text") {
+                format = SnapshotFormat::Text;
+            } else if (name == "binary") {
+                format = SnapshotFormat::Binary;
+            } else {
+                ok = false;
+            }
+        } else if (output.empty() && arg.compare(0, 2, "--") != 0) {
+            output = arg;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "bad argument: " << arg << "\nusage: " << argv[0] << usage << std::endl;
+            return 1;
+        }
+    }
+    if (output.empty()) {
+        std::cerr << "usage: " << argv[0] << usage << std::endl;
+        return 1;
+    }
+
+    try {
+        generateWorldFile(spec, output, format);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}